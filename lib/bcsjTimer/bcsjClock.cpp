@@ -0,0 +1,32 @@
+
+#include "bcsjTimer.h"
+
+#if defined(BCSJ_VIRTUAL_CLOCK)
+
+bcsjTime64 bcsjVirtualNow = 0;
+
+
+/*---------------------------------------------------------------------------
+** SET VIRTUAL CLOCK
+**
+** Jumps the virtual clock to now.  Time only moves forward.
+**--------------------------------------------------------------------------*/
+void bcsjClockSet( bcsjTime64 now )
+{
+  if (now > bcsjVirtualNow) {
+    bcsjVirtualNow = now;
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** ADVANCE VIRTUAL CLOCK
+**
+** Moves the virtual clock forward by us microseconds
+**--------------------------------------------------------------------------*/
+void bcsjClockAdvance( bcsjTime64 us )
+{
+  bcsjVirtualNow += us;
+}
+
+#endif
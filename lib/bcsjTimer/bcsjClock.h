@@ -0,0 +1,55 @@
+/*
+  bcsjClock.h - time source behind every bcsjTimer
+
+  Selected at compile time so the target pays nothing for it:
+
+    default             bcsjNow() is the 64-bit esp_timer count on the ESP32,
+                        or micros() widened to 64 bits elsewhere (needs a
+                        call at least once per wrap)
+
+    BCSJ_VIRTUAL_CLOCK  bcsjNow() returns a variable that only moves when
+                        told to, for host builds.  A test can jump minutes
+                        ahead in one call instead of waiting them out.
+*/
+
+
+#ifndef __BCSJCLOCK_H__
+#define __BCSJCLOCK_H__
+
+#if defined(BCSJ_VIRTUAL_CLOCK)
+
+extern bcsjTime64 bcsjVirtualNow;
+
+inline bcsjTime64 bcsjNow( void )
+{
+  return bcsjVirtualNow;
+}
+
+void bcsjClockSet( bcsjTime64 now );       // jump to an absolute time
+void bcsjClockAdvance( bcsjTime64 us );    // move time forward by us
+
+#else
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include "esp_timer.h"
+#endif
+
+inline bcsjTime64 bcsjNow( void )
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  return (bcsjTime64)esp_timer_get_time();
+#else
+  static bcsjTime   lastLow = 0;
+  static bcsjTime64 high    = 0;
+  bcsjTime low = micros();
+  if (low < lastLow) {
+    high += 0x100000000ULL;
+  }
+  lastLow = low;
+  return high + low;
+#endif
+}
+
+#endif
+
+#endif
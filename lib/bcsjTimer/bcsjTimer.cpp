@@ -12,6 +12,9 @@ bcsjTimer::bcsjTimer(void)
   startTime = 0;
   deltaTime = 0;
   timerEnabled = true;
+  fired = true;
+  heapIndex = -1;
+  callback = NULL;
 }
 
 
@@ -19,11 +22,12 @@ bcsjTimer::bcsjTimer(void)
 ** START TIMER
 **
 **--------------------------------------------------------------------------*/
-void bcsjTimer::start( bcsjTime interval )
+void bcsjTimer::start( bcsjTime64 interval )
 {
-  startTime = micros();
+  startTime = bcsjNow();
   deltaTime = interval;
   timerEnabled = true;
+  bcsjTimers.schedule(this);
 }
 
 
@@ -38,9 +42,10 @@ void bcsjTimer::restart( void )
     startTime += deltaTime;
   }
   else {
-    startTime = micros();
+    startTime = bcsjNow();
     timerEnabled = true;
   }
+  bcsjTimers.schedule(this);
 }
 
 
@@ -49,16 +54,17 @@ void bcsjTimer::restart( void )
 **
 ** Restart timer with new time interval
 **--------------------------------------------------------------------------*/
-void bcsjTimer::restart( bcsjTime interval )
+void bcsjTimer::restart( bcsjTime64 interval )
 {
   if (timerEnabled) {
     startTime += deltaTime;
   }
   else {
-    startTime = micros();
+    startTime = bcsjNow();
     timerEnabled = true;
   }
   deltaTime = interval;
+  bcsjTimers.schedule(this);
 }
 
 
@@ -73,10 +79,9 @@ boolean bcsjTimer::running( void )
   if (!timerEnabled) {
     return false;
   }
-  if ((micros()-startTime) < deltaTime) {
-    return true;
-  }
-  return false;
+  bcsjTimers.poll();
+  checkUnqueued();
+  return !fired;
 }
 
 
@@ -89,14 +94,29 @@ boolean bcsjTimer::running( void )
 boolean bcsjTimer::done( void )
 {
   if (timerEnabled) {
-    if ((micros()-startTime) >= deltaTime) {
-      return true;
-    }
+    bcsjTimers.poll();
+    checkUnqueued();
+    return fired;
   }
   return false;
 }
 
 
+/*---------------------------------------------------------------------------
+** UNQUEUED TIMER
+**
+** A timer started while the heap was full is not in it, and poll() would
+** never mark it fired; its deadline is compared here instead.  Its
+** callback is not called.
+**--------------------------------------------------------------------------*/
+void bcsjTimer::checkUnqueued( void )
+{
+  if (heapIndex < 0 && !fired && bcsjNow() >= startTime + deltaTime) {
+    fired = true;
+  }
+}
+
+
 /*---------------------------------------------------------------------------
 ** ACTIVE TIMER
 **
@@ -118,6 +138,7 @@ void bcsjTimer::disable( void )
 {
   deltaTime = 0L;
   timerEnabled = false;
+  bcsjTimers.cancel(this);
 }
 
 
@@ -125,31 +146,38 @@ void bcsjTimer::disable( void )
 ** DELTA
 **
 ** Returns how long the timer has been running in microseconds
-**         0xffffffff if the timer is disabled
+**         MAXTIMEVALUE if the timer is disabled
 **--------------------------------------------------------------------------*/
-bcsjTime bcsjTimer::delta( void )
+bcsjTime64 bcsjTimer::delta( void )
 {
   if (timerEnabled) {
-    return micros()-startTime;
+    return bcsjNow()-startTime;
   }
-  return 0xffffffff;
+  return MAXTIMEVALUE;
 }
 
 
 /*---------------------------------------------------------------------------
-** GET START TIME
+** TEST TIMER
 **
-** Returns how long the timer has been running in microseconds
-**         0xffffffff if the timer is disabled
+** Returns microseconds since the deadline passed (wraps if still running)
+**         0 if the timer is disabled
 **--------------------------------------------------------------------------*/
-bcsjTime bcsjTimer::test( void )
+bcsjTime64 bcsjTimer::test( void )
 {
   if (timerEnabled) {
-    return micros() - (startTime + deltaTime);
+    return bcsjNow() - (startTime + deltaTime);
   }
   return 0;
 }
 
 
-
-
+/*---------------------------------------------------------------------------
+** ATTACH CALLBACK
+**
+** cb is called by bcsjTimers.poll() each time the timer expires
+**--------------------------------------------------------------------------*/
+void bcsjTimer::attach( bcsjCallback cb )
+{
+  callback = cb;
+}
@@ -7,38 +7,62 @@
 #ifndef __BCSJTIMER_H__
 #define __BCSJTIMER_H__
 
-#include "arduino.h"
+#include "Arduino.h"
 
-typedef unsigned long bcsjTime;
+typedef unsigned long bcsjTime;            // 32-bit micros(), wraps every ~71.6 minutes
+typedef uint64_t      bcsjTime64;          // 64-bit microseconds, never wraps in practice
+
+#include "bcsjClock.h"
+
+//
+// Duration helpers - the multiply is done in 64 bits so hours of power
+// window never overflow the way 1000000L * 60 * n does in 32 bits
+//
+inline bcsjTime64 bcsjMillis( uint32_t ms )     { return (bcsjTime64)ms * 1000ULL; }
+inline bcsjTime64 bcsjSeconds( uint32_t secs )  { return (bcsjTime64)secs * 1000000ULL; }
+inline bcsjTime64 bcsjMinutes( uint32_t mins )  { return (bcsjTime64)mins * 60000000ULL; }
+inline bcsjTime64 bcsjHours( uint32_t hours )   { return (bcsjTime64)hours * 3600000000ULL; }
+
+class bcsjTimer;
+typedef void (*bcsjCallback)( bcsjTimer *timer );
 
 class bcsjTimer
 {
 
-#define MAXTIMEVALUE 0xffffffff
+#define MAXTIMEVALUE 0xffffffffffffffffULL
 
   //
   // PUBLIC function definitons
   //
   public:
              bcsjTimer();                  // constructor
-    void     start( bcsjTime interval );   // start a timer running
+    void     start( bcsjTime64 interval ); // start a timer running
     void     restart( void );              // start a timer running from previous startTime + deltaTime
-    void     restart( bcsjTime interval ); // start a timer running from previous startTime + deltaTime
+    void     restart( bcsjTime64 interval );// start a timer running from previous startTime + deltaTime
     boolean  running( void );              // is timer still running?
     boolean  done( void );                 // has timer finished?
     boolean  active( void );               // is timer active?
     void     disable( void );              // mark time inactive
-    bcsjTime delta( void );                // returns microseconds since timer started
-    bcsjTime test( void );                 // returns microseconds since timer started
+    bcsjTime64 delta( void );              // returns microseconds since timer started
+    bcsjTime64 test( void );               // returns microseconds past the deadline
+    void     attach( bcsjCallback cb );    // call cb from bcsjTimers.poll() when timer expires
    
 
   private:
     boolean  timerEnabled;                 // timer is active?
-    bcsjTime startTime;                    // beginning of this time span
-    bcsjTime deltaTime;                    // the duration of this time span
+    bcsjTime64 startTime;                  // beginning of this time span
+    bcsjTime64 deltaTime;                  // the duration of this time span
+    boolean  fired;                        // deadline has passed, set by bcsjTimers.poll()
+    int8_t   heapIndex;                    // slot in the bcsjTimers heap, -1 if not queued
+    bcsjCallback callback;                 // optional expiry callback
 
+    void     checkUnqueued( void );        // deadline check for a timer left out of the heap
+
+  friend class bcsjTimerService;
 };
 
+#include "bcsjTimerService.h"
+
 #endif
 
 
@@ -0,0 +1,212 @@
+
+#include "bcsjTimer.h"
+
+bcsjTimerService bcsjTimers;
+
+//
+// Deadlines are 64-bit bcsjNow() microseconds, so they compare directly
+//
+#define DEADLINE(t) ((t)->startTime + (t)->deltaTime)
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**
+** Empty queue
+**--------------------------------------------------------------------------*/
+bcsjTimerService::bcsjTimerService(void)
+{
+  count      = 0;
+  overflowed = 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** SCHEDULE
+**
+** Marks timer as running and puts it in the heap, or moves it if it was
+** already queued
+**--------------------------------------------------------------------------*/
+void bcsjTimerService::schedule( bcsjTimer *timer )
+{
+  timer->fired = false;
+  if (timer->heapIndex < 0) {
+    if (count >= BCSJ_MAX_TIMERS) {
+      if (overflowed < 0xFFFF) overflowed++;   // running() checks its deadline
+      return;
+    }
+    place(count++, timer);
+    siftUp(timer->heapIndex);
+  }
+  else {
+    siftUp(timer->heapIndex);
+    siftDown(timer->heapIndex);
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** CANCEL
+**
+** Removes timer from the heap without firing it
+**--------------------------------------------------------------------------*/
+void bcsjTimerService::cancel( bcsjTimer *timer )
+{
+  if (timer->heapIndex >= 0) {
+    removeAt(timer->heapIndex);
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** POLL
+**
+** Reads the clock once and fires every timer whose deadline has passed,
+** earliest first
+**--------------------------------------------------------------------------*/
+void bcsjTimerService::poll( void )
+{
+  bcsjTime64 now = bcsjNow();
+
+  while (count > 0 && now >= DEADLINE(heap[0])) {
+    bcsjTimer *timer = heap[0];
+    removeAt(0);
+    timer->fired = true;
+    if (timer->callback != NULL) {
+      timer->callback(timer);              // may restart the timer
+    }
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** PENDING
+**
+** Returns true if any timer is waiting for its deadline
+**--------------------------------------------------------------------------*/
+boolean bcsjTimerService::pending( void )
+{
+  return count > 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** OVERFLOWS
+**
+** Returns how many times a timer found the heap full
+**--------------------------------------------------------------------------*/
+uint16_t bcsjTimerService::overflows( void )
+{
+  return overflowed;
+}
+
+
+/*---------------------------------------------------------------------------
+** UNTIL NEXT
+**
+** Returns microseconds until the earliest deadline
+**         0 if it has already passed
+**         MAXTIMEVALUE if no timer is queued
+**--------------------------------------------------------------------------*/
+bcsjTime64 bcsjTimerService::untilNext( void )
+{
+  if (count == 0) {
+    return MAXTIMEVALUE;
+  }
+  bcsjTime64 now = bcsjNow();
+  if (now >= DEADLINE(heap[0])) {
+    return 0;
+  }
+  return DEADLINE(heap[0]) - now;
+}
+
+
+/*---------------------------------------------------------------------------
+** WAIT NEXT
+**
+** Blocks until the earliest deadline or maxWait microseconds, whichever
+** comes first, then polls.  delay() lets the RTOS idle the core; a
+** virtual clock simply jumps ahead.
+**--------------------------------------------------------------------------*/
+void bcsjTimerService::waitNext( bcsjTime64 maxWait )
+{
+  bcsjTime64 wait = untilNext();
+  if (wait > maxWait) {
+    wait = maxWait;
+  }
+#if defined(BCSJ_VIRTUAL_CLOCK)
+  bcsjClockAdvance(wait);                  // no waiting on a virtual clock
+#else
+  if (wait >= 1000) {
+    delay(wait / 1000);
+  }
+  else if (wait > 0) {
+    delayMicroseconds(wait);
+  }
+#endif
+  poll();
+}
+
+
+/*---------------------------------------------------------------------------
+** HEAP HELPERS
+**
+**--------------------------------------------------------------------------*/
+boolean bcsjTimerService::before( bcsjTimer *a, bcsjTimer *b )
+{
+  return DEADLINE(a) < DEADLINE(b);
+}
+
+void bcsjTimerService::place( int8_t slot, bcsjTimer *timer )
+{
+  heap[slot] = timer;
+  timer->heapIndex = slot;
+}
+
+void bcsjTimerService::siftUp( int8_t slot )
+{
+  while (slot > 0) {
+    int8_t parent = (slot - 1) / 2;
+    if (!before(heap[slot], heap[parent])) {
+      break;
+    }
+    bcsjTimer *t = heap[parent];
+    place(parent, heap[slot]);
+    place(slot, t);
+    slot = parent;
+  }
+}
+
+void bcsjTimerService::siftDown( int8_t slot )
+{
+  for (;;) {
+    int8_t least = slot;
+    int8_t left  = 2 * slot + 1;
+    int8_t right = left + 1;
+    if (left < count && before(heap[left], heap[least])) {
+      least = left;
+    }
+    if (right < count && before(heap[right], heap[least])) {
+      least = right;
+    }
+    if (least == slot) {
+      break;
+    }
+    bcsjTimer *t = heap[least];
+    place(least, heap[slot]);
+    place(slot, t);
+    slot = least;
+  }
+}
+
+void bcsjTimerService::removeAt( int8_t slot )
+{
+  heap[slot]->heapIndex = -1;
+  count--;
+  if (slot < count) {
+    bcsjTimer *moved = heap[count];        // last leaf fills the hole
+    place(slot, moved);
+    siftUp(slot);
+    siftDown(moved->heapIndex);
+  }
+}
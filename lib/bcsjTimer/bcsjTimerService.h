@@ -0,0 +1,53 @@
+/*
+  bcsjTimerService.h - deadline heap behind the bcsjTimer objects
+
+  Every running bcsjTimer is kept in a small min-heap ordered by deadline,
+  so poll() only has to read the clock once and look at the earliest one.
+  Expired timers are marked fired and their callback, if any, is called.
+
+  A timer started with all BCSJ_MAX_TIMERS slots taken is counted in
+  overflows() and still ends on time: running() and done() compare its
+  deadline themselves.  Only its callback is lost.
+*/
+
+
+#ifndef __BCSJTIMERSERVICE_H__
+#define __BCSJTIMERSERVICE_H__
+
+#include "bcsjTimer.h"
+
+#define BCSJ_MAX_TIMERS 8
+
+class bcsjTimerService
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+             bcsjTimerService();           // constructor
+    void     schedule( bcsjTimer *timer ); // (re)queue timer at startTime + deltaTime
+    void     cancel( bcsjTimer *timer );   // drop timer from the queue
+    void     poll( void );                 // fire every timer whose deadline has passed
+    boolean  pending( void );              // any timer queued?
+    bcsjTime64 untilNext( void );          // microseconds to the next deadline
+    void     waitNext( bcsjTime64 maxWait );// block until next deadline or maxWait, then poll
+    uint16_t overflows( void );            // timers started while the heap was full
+
+
+  private:
+    bcsjTimer *heap[BCSJ_MAX_TIMERS];      // heap[0] has the earliest deadline
+    int8_t     count;                      // timers in the heap
+    uint16_t   overflowed;
+
+    boolean  before( bcsjTimer *a, bcsjTimer *b );
+    void     place( int8_t slot, bcsjTimer *timer );
+    void     siftUp( int8_t slot );
+    void     siftDown( int8_t slot );
+    void     removeAt( int8_t slot );
+
+};
+
+extern bcsjTimerService bcsjTimers;
+
+#endif
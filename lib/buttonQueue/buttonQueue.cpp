@@ -0,0 +1,207 @@
+
+#include "buttonQueue.h"
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**
+** Empty queues, button up, OneButton's default timing
+**--------------------------------------------------------------------------*/
+buttonQueue::buttonQueue(void)
+{
+  edgeHead = edgeTail = 0;
+  gestureHead = gestureTail = 0;
+  edgesLost = gesturesLost = 0;
+  debounceTime  = bcsjMillis(50);
+  clickTime     = bcsjMillis(400);
+  longPressTime = bcsjMillis(800);
+  candidateValid = false;
+  candidateLevel = false;
+  candidateStamp = 0;
+  down = false;
+  longFired = false;
+  clicks = 0;
+  downStamp = upStamp = 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** SET TIMES
+**
+**--------------------------------------------------------------------------*/
+void buttonQueue::setTimes( bcsjTime64 debounce, bcsjTime64 clickWindow, bcsjTime64 longPress )
+{
+  debounceTime  = debounce;
+  clickTime     = clickWindow;
+  longPressTime = longPress;
+}
+
+
+/*---------------------------------------------------------------------------
+** EDGE
+**
+** Called from the pin interrupt.  Single producer, so only edgeHead moves
+** here.  With the ring full the newest queued edge is replaced, so the
+** level the button ends up at is never the one lost: dropping the final
+** release of a bounce burst would leave it held down and make a long
+** press.  The edge in between only shortens a burst update() collapses
+** anyway, and it is counted.
+**--------------------------------------------------------------------------*/
+void IRAM_ATTR buttonQueue::edge( boolean pressed, bcsjTime64 stamp )
+{
+  uint8_t head = edgeHead;
+  uint8_t nextHead = (head + 1) & (BTN_EDGE_SLOTS - 1);
+  if (nextHead == edgeTail) {
+    uint8_t newest = (head - 1) & (BTN_EDGE_SLOTS - 1);   // far from edgeTail
+    edges[newest].stamp   = stamp;
+    edges[newest].pressed = pressed;
+    edgesLost++;
+    return;
+  }
+  edges[head].stamp   = stamp;
+  edges[head].pressed = pressed;
+  edgeHead = nextHead;
+}
+
+
+/*---------------------------------------------------------------------------
+** UPDATE
+**
+** Drains the edge ring.  An edge only becomes a level change once no other
+** edge follows it within debounceTime, so contact bounce collapses into
+** the last level it settled at.  Then the click window and long press
+** are checked against now.
+**--------------------------------------------------------------------------*/
+void buttonQueue::update( bcsjTime64 now )
+{
+  while (edgeTail != edgeHead) {
+    uint8_t tail = edgeTail;
+    bcsjTime64 stamp = edges[tail].stamp;
+    boolean level    = edges[tail].pressed;
+    edgeTail = (tail + 1) & (BTN_EDGE_SLOTS - 1);
+
+    if (candidateValid && (stamp - candidateStamp) >= debounceTime) {
+      commit(candidateLevel, candidateStamp);
+    }
+    candidateValid = true;
+    candidateLevel = level;
+    candidateStamp = stamp;
+  }
+  if (candidateValid && (now - candidateStamp) >= debounceTime) {
+    commit(candidateLevel, candidateStamp);
+    candidateValid = false;
+  }
+
+  if (down && !longFired && (now - downStamp) >= longPressTime) {
+    longFired = true;
+    clicks = 0;
+    push(BTN_LONGPRESS);
+  }
+  if (!down && clicks == 1 && (now - upStamp) >= clickTime) {
+    clicks = 0;
+    push(BTN_CLICK);
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** NEXT
+**
+** Returns the oldest gesture and removes it from the queue
+**         BTN_NONE if the queue is empty
+**--------------------------------------------------------------------------*/
+uint8_t buttonQueue::next( void )
+{
+  if (gestureTail == gestureHead) {
+    return BTN_NONE;
+  }
+  uint8_t gesture = gestures[gestureTail];
+  gestureTail = (gestureTail + 1) & (BTN_GESTURE_SLOTS - 1);
+  return gesture;
+}
+
+
+/*---------------------------------------------------------------------------
+** INJECT
+**
+** Queues a gesture that did not come from the pin, e.g. a command on the
+** serial line, behind the ones already waiting
+**--------------------------------------------------------------------------*/
+void buttonQueue::inject( uint8_t gesture )
+{
+  push(gesture);
+}
+
+
+/*---------------------------------------------------------------------------
+** PRESSED
+**
+** Returns true while the debounced button is held down
+**--------------------------------------------------------------------------*/
+boolean buttonQueue::pressed( void )
+{
+  return down;
+}
+
+
+/*---------------------------------------------------------------------------
+** DROPPED
+**
+** Returns the number of edges and gestures lost to a full queue
+**--------------------------------------------------------------------------*/
+uint16_t buttonQueue::dropped( void )
+{
+  return edgesLost + gesturesLost;
+}
+
+
+/*---------------------------------------------------------------------------
+** COMMIT
+**
+** A debounced level change at stamp
+**--------------------------------------------------------------------------*/
+void buttonQueue::commit( boolean level, bcsjTime64 stamp )
+{
+  if (level == down) {
+    return;                                // bounced back to where it was
+  }
+  down = level;
+  if (down) {
+    if (clicks == 1 && (stamp - upStamp) >= clickTime) {
+      clicks = 0;                          // window ran out before update() saw it
+      push(BTN_CLICK);
+    }
+    downStamp = stamp;
+    longFired = false;
+    return;
+  }
+  if (longFired || (stamp - downStamp) >= longPressTime) {
+    if (!longFired) {
+      push(BTN_LONGPRESS);                 // held and released between updates
+    }
+    longFired = false;
+    clicks = 0;
+    return;
+  }
+  upStamp = stamp;
+  if (++clicks == 2) {
+    clicks = 0;
+    push(BTN_DOUBLECLICK);
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** PUSH
+**
+**--------------------------------------------------------------------------*/
+void buttonQueue::push( uint8_t gesture )
+{
+  uint8_t nextHead = (gestureHead + 1) & (BTN_GESTURE_SLOTS - 1);
+  if (nextHead == gestureTail) {
+    gesturesLost++;
+    return;
+  }
+  gestures[gestureHead] = gesture;
+  gestureHead = nextHead;
+}
@@ -0,0 +1,73 @@
+/*
+  buttonQueue.h - interrupt fed push button decoder
+
+  The pin interrupt hands every edge, with its bcsjNow() timestamp, to
+  edge().  update() debounces those edges and sorts them into click,
+  double-click and long-press gestures, which wait in a small queue until
+  next() takes them.  Nothing is lost while the caller is busy elsewhere;
+  gestures are classified from the edge timestamps, not from when they
+  are read.  inject() queues a gesture from elsewhere, the serial line,
+  to be taken by next() like the rest.
+*/
+
+
+#ifndef __BUTTONQUEUE_H__
+#define __BUTTONQUEUE_H__
+
+#include "bcsjTimer.h"
+
+#define BTN_EDGE_SLOTS     16              // must be a power of two
+#define BTN_GESTURE_SLOTS  8               // must be a power of two
+
+enum buttonGesture : uint8_t {BTN_NONE, BTN_CLICK, BTN_DOUBLECLICK, BTN_LONGPRESS};
+
+class buttonQueue
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+             buttonQueue();                // constructor
+    void     setTimes( bcsjTime64 debounce, bcsjTime64 clickWindow, bcsjTime64 longPress );
+    void     edge( boolean pressed, bcsjTime64 stamp );  // call from the pin ISR
+    void     update( bcsjTime64 now );     // turn edges into gestures
+    uint8_t  next( void );                 // oldest gesture, BTN_NONE if empty
+    void     inject( uint8_t gesture );    // queue one as if it came from the pin
+    boolean  pressed( void );              // debounced state
+    uint16_t dropped( void );              // edges or gestures lost to a full queue
+
+
+  private:
+    struct btnEdge {
+      bcsjTime64 stamp;
+      boolean    pressed;
+    };
+    volatile btnEdge edges[BTN_EDGE_SLOTS];   // written by the ISR only at edgeHead
+    volatile uint8_t edgeHead;
+    volatile uint8_t edgeTail;
+    uint8_t    gestures[BTN_GESTURE_SLOTS];
+    uint8_t    gestureHead;
+    uint8_t    gestureTail;
+    volatile uint16_t edgesLost;           // ISR side
+    uint16_t   gesturesLost;
+
+    bcsjTime64 debounceTime;               // level must hold this long to count
+    bcsjTime64 clickTime;                  // second click must start within this
+    bcsjTime64 longPressTime;              // held this long is a long press
+
+    boolean    candidateValid;             // edge waiting out the debounce time
+    boolean    candidateLevel;
+    bcsjTime64 candidateStamp;
+    boolean    down;                       // debounced level
+    boolean    longFired;                  // long press already reported for this hold
+    uint8_t    clicks;                     // releases waiting on the click window
+    bcsjTime64 downStamp;
+    bcsjTime64 upStamp;
+
+    void     commit( boolean level, bcsjTime64 stamp );
+    void     push( uint8_t gesture );
+
+};
+
+#endif
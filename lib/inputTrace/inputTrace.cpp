@@ -0,0 +1,159 @@
+#include "inputTrace.h"
+
+inputTrace trace;
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+inputTrace::inputTrace(void)
+{
+  recCount  = 0;
+  recLost   = 0;
+  bootLen   = 0;
+  recording = false;
+  startTime = 0;
+  lastTime  = 0;
+  out       = NULL;
+  crc       = 0xFFFF;
+}
+
+
+/*---------------------------------------------------------------------------
+** BEGIN
+**
+** Blobs that do not fit in TRACE_BOOT_MAX are left out whole; the replay
+** then boots without them.
+**--------------------------------------------------------------------------*/
+void inputTrace::begin( const nvsBlob *blobs, uint8_t count, bcsjTime64 now )
+{
+  recCount  = 0;
+  recLost   = 0;
+  bootLen   = 0;
+  startTime = now;
+  lastTime  = now;
+  for (uint8_t i = 0; i < count; i++) {
+    size_t keyLen = strlen(blobs[i].key);
+    if (keyLen > 255 || blobs[i].len > 255 ||
+        bootLen + 2 + keyLen + blobs[i].len > TRACE_BOOT_MAX) {
+      continue;
+    }
+    boot[bootLen++] = keyLen;
+    memcpy(&boot[bootLen], blobs[i].key, keyLen);
+    bootLen += keyLen;
+    boot[bootLen++] = blobs[i].len;
+    memcpy(&boot[bootLen], blobs[i].buf, blobs[i].len);
+    bootLen += blobs[i].len;
+  }
+  recording = true;
+}
+
+
+/*---------------------------------------------------------------------------
+** LOG
+**--------------------------------------------------------------------------*/
+void inputTrace::log( uint8_t kind, uint8_t arg, uint16_t value, bcsjTime64 now )
+{
+  if (recording == false) {
+    return;
+  }
+  if (recCount >= TRACE_DEPTH) {
+    if (recLost < 0xFFFF) recLost++;
+    return;
+  }
+  bcsjTime64 dt = now - lastTime;
+  lastTime = now;
+  traceRec &r = recs[recCount++];
+  r.dt    = dt > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)dt;
+  r.kind  = kind;
+  r.arg   = arg & 0x3F;
+  r.value = value;
+}
+
+
+/*---------------------------------------------------------------------------
+** ACCESSORS
+**--------------------------------------------------------------------------*/
+boolean inputTrace::active( void )
+{
+  return recording;
+}
+
+bcsjTime64 inputTrace::started( void )
+{
+  return startTime;
+}
+
+uint16_t inputTrace::count( void )
+{
+  return recCount;
+}
+
+uint16_t inputTrace::lost( void )
+{
+  return recLost;
+}
+
+
+/*---------------------------------------------------------------------------
+** DUMP
+**
+** Sizes the body first so the header can carry its length; a reader can
+** then pick the frame out of a serial log with text around it.
+**--------------------------------------------------------------------------*/
+void inputTrace::put( uint8_t c )
+{
+  crc ^= (uint16_t)c << 8;
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+  }
+  out(c);
+}
+
+uint8_t inputTrace::varintLen( uint32_t v )
+{
+  uint8_t n = 1;
+  while (v >= 0x80) {
+    v >>= 7;
+    n++;
+  }
+  return n;
+}
+
+void inputTrace::putVarint( uint32_t v )
+{
+  while (v >= 0x80) {
+    put((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  put(v);
+}
+
+void inputTrace::dump( tracePut put_, bcsjTime64 now )
+{
+  uint32_t body = 0;
+  for (uint16_t i = 0; i < recCount; i++) {
+    body += varintLen(recs[i].dt) + 1 + varintLen(recs[i].value);
+  }
+  bcsjTime64 span = now - startTime;
+  uint32_t   span32 = span > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)span;
+
+  out = put_;
+  out('B'); out('T'); out('R'); out('C');
+  crc = 0xFFFF;
+  put(TRACE_VERSION);
+  put(bootLen);
+  put(recCount);  put(recCount >> 8);
+  put(recLost);   put(recLost >> 8);
+  for (uint8_t b = 0; b < 32; b += 8) put(span32 >> b);
+  for (uint8_t b = 0; b < 32; b += 8) put(body >> b);
+  for (uint8_t i = 0; i < bootLen; i++) put(boot[i]);
+  for (uint16_t i = 0; i < recCount; i++) {
+    putVarint(recs[i].dt);
+    put((recs[i].kind << 6) | recs[i].arg);
+    putVarint(recs[i].value);
+  }
+  uint16_t sum = crc;
+  out(sum);
+  out(sum >> 8);
+}
@@ -0,0 +1,93 @@
+/*
+  inputTrace.h - record the panel's inputs and outputs for replay on the host
+
+  From begin() on, every input edge the firmware polls (sensor beams,
+  encoder A/B, encoder switch) and every output it drives (route word
+  latched into the shift register, track power, state machine mode) is
+  logged with its time into a fixed RAM buffer.  When the buffer is full
+  further records are only counted as lost, so a trace always reaches
+  back to boot and can be played from there.
+
+  begin() also keeps the NVS blobs setup() booted from, so the replay
+  can put the same config and occupancy in front of the same firmware.
+
+  dump() sends the whole trace as one binary frame, little endian:
+
+    "BTRC"  magic
+    u8      version
+    u8      boot bytes
+    u16     records
+    u16     lost, records that did not fit
+    u32     span, us from begin() to the dump
+    u32     body bytes
+    boot    per blob: key length, key, blob length, blob
+    body    per record: varint us since the record before,
+            kind << 6 | arg, varint value
+    u16     CRC-16/CCITT of everything after the magic
+
+  For TRACE_PIN records arg is the GPIO number and value its level, or
+  arg is TRACE_REMOTE, which no GPIO has, for an action that came as a
+  command on the serial line: value is its letter << 8 | its number,
+  0xFF for none.
+*/
+
+
+#ifndef __INPUTTRACE_H__
+#define __INPUTTRACE_H__
+
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+
+#define TRACE_DEPTH      2048              // records, 8 bytes each
+#define TRACE_BOOT_MAX   96                // bytes of boot blobs
+#define TRACE_VERSION    1
+
+enum traceKind : uint8_t {TRACE_PIN, TRACE_ROUTE, TRACE_POWER, TRACE_MODE};
+#define TRACE_REMOTE     0x3F              // TRACE_PIN arg of a serial command
+
+typedef void (*tracePut)( uint8_t c );
+
+class inputTrace
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+               inputTrace();               // constructor
+    void       begin( const nvsBlob *blobs, uint8_t count, bcsjTime64 now ); // empty it, start recording
+    void       log( uint8_t kind, uint8_t arg, uint16_t value, bcsjTime64 now );
+    boolean    active( void );             // begin() has been called
+    bcsjTime64 started( void );            // bcsjNow() at begin()
+    uint16_t   count( void );
+    uint16_t   lost( void );
+    void       dump( tracePut put, bcsjTime64 now ); // one frame, see above
+
+
+  private:
+    struct traceRec {
+      uint32_t dt;                         // us since the record before, saturates
+      uint8_t  kind;
+      uint8_t  arg;
+      uint16_t value;
+    };
+    traceRec   recs[TRACE_DEPTH];
+    uint16_t   recCount;
+    uint16_t   recLost;
+    uint8_t    boot[TRACE_BOOT_MAX];
+    uint8_t    bootLen;
+    boolean    recording;
+    bcsjTime64 startTime;
+    bcsjTime64 lastTime;
+
+    tracePut   out;                        // dump() state
+    uint16_t   crc;
+    void       put( uint8_t c );
+    void       putVarint( uint32_t v );
+    uint8_t    varintLen( uint32_t v );
+
+};
+
+extern inputTrace trace;
+
+#endif
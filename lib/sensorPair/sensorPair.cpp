@@ -0,0 +1,81 @@
+
+#include "sensorPair.h"
+
+
+/*---------------------------------------------------------------------------
+** INIT
+**
+** Both beams open
+**--------------------------------------------------------------------------*/
+void sensorPairInit( sensorPair &pair )
+{
+  memset(&pair, 0, sizeof(pair));
+  pair.inLast  = HIGH;
+  pair.outLast = HIGH;
+}
+
+
+/*---------------------------------------------------------------------------
+** EDGE
+**
+** One beam changed.  The last beam to clear decides the PassBy.
+**--------------------------------------------------------------------------*/
+static boolean pairEdge( sensorPair &pair, byte beam, byte blocked )
+{
+  if (blocked) {
+    if (pair.report == 0) {
+      pair.first = beam;
+      pair.seen  = 0;
+    }
+    pair.report |= beam;
+    pair.seen   |= beam;
+  }
+  else {
+    pair.report &= ~beam;
+  }
+
+  if (pair.report > 0) {
+    uint16_t total = pair.total + pair.report;
+    pair.total = total > PAIR_TOTAL_MAX ? PAIR_TOTAL_MAX : total;
+    return false;
+  }
+  boolean passBy = pair.total > 0 && pair.seen == (PAIR_IN | PAIR_OUT) && beam != pair.first;
+  pair.total = 0;
+  return passBy;
+}
+
+
+/*---------------------------------------------------------------------------
+** UPDATE
+**
+** Called every pass with the debounced levels.  The In edge is taken
+** before the Out edge when both moved in the same pass.
+**--------------------------------------------------------------------------*/
+boolean sensorPairUpdate( sensorPair &pair, byte inValue, byte outValue )
+{
+  boolean passBy = false;
+  if (inValue != pair.inLast) {
+    pair.inLast = inValue;
+    passBy |= pairEdge(pair, PAIR_IN, inValue == LOW);
+  }
+  if (outValue != pair.outLast) {
+    pair.outLast = outValue;
+    passBy |= pairEdge(pair, PAIR_OUT, outValue == LOW);
+  }
+
+  if (passBy) {
+    pair.passByState = true;
+  }
+  if ((pair.total == PAIR_OUT) && (pair.report == PAIR_OUT)) {
+    pair.direction     = PAIR_OUTBOUND;
+    pair.lastDirection = PAIR_OUTBOUND;
+  }
+  else if ((pair.total == PAIR_IN) && (pair.report == PAIR_IN)) {
+    pair.direction     = PAIR_INBOUND;
+    pair.lastDirection = PAIR_INBOUND;
+  }
+  if ((pair.total == 0) && (pair.report == 0)) {
+    pair.direction = 0;
+  }
+  return passBy;
+}
@@ -0,0 +1,44 @@
+/*
+  sensorPair.h - PassBy and direction decoder for one In/Out beam pair
+
+  Both mainSens and revSens are a pair of IR beams a short way apart on
+  the track.  report holds which beams are blocked, total adds report up
+  at every edge until the pair is clear again, and the first beam blocked
+  gives the direction.  A PassBy is a train that blocked one beam, then
+  both, and cleared the other beam last: it went all the way through.
+
+  total saturates instead of wrapping, so a sensor chattering under a
+  standing train cannot bring it back round to 1 or 2 and flip the
+  direction.  A train that backs out over the beam it came in on clears
+  that beam last, and is not a PassBy.
+*/
+
+
+#ifndef __SENSORPAIR_H__
+#define __SENSORPAIR_H__
+
+#include "Arduino.h"
+
+#define PAIR_IN          0x01              // report bits: beam blocked
+#define PAIR_OUT         0x02
+#define PAIR_INBOUND     1                 // In beam blocked first
+#define PAIR_OUTBOUND    2                 // Out beam blocked first
+#define PAIR_TOTAL_MAX   255
+
+struct sensorPair
+{
+  byte report;                             // PAIR_IN | PAIR_OUT, blocked now
+  byte total;                              // sum of report at each edge, 0 when clear
+  byte passByState;                        // set on a PassBy, the caller clears it
+  byte direction;                          // 0 while clear, else PAIR_INBOUND/OUTBOUND
+  byte lastDirection;                      // direction of the last train, kept when clear
+  byte inLast;                             // debounced levels from the last update
+  byte outLast;
+  byte first;                              // beam blocked first since clear
+  byte seen;                               // beams blocked since clear
+};
+
+void    sensorPairInit( sensorPair &pair );
+boolean sensorPairUpdate( sensorPair &pair, byte inValue, byte outValue ); // LOW = blocked,
+                                                                           // true on a PassBy
+#endif
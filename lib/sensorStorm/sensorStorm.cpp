@@ -0,0 +1,233 @@
+
+#include "sensorStorm.h"
+
+#define STORM_CHATTER_STEP  ((bcsjTime64)700)  // IR receiver hunting at the threshold, us
+#define STORM_CHATTER_EDGES 12
+#define STORM_GLITCH_TIME   bcsjMillis(1)
+#define STORM_SETTLE        bcsjMillis(100)    // quiet time after the last edge
+
+sensorStorm storm;
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+sensorStorm::sensorStorm(void)
+{
+  count   = 0;
+  played  = 0;
+  playing = false;
+  memset(&result, 0, sizeof(result));
+}
+
+
+/*---------------------------------------------------------------------------
+** CASE NAMES
+**--------------------------------------------------------------------------*/
+const char *sensorStorm::name( uint8_t id )
+{
+  static const char *const names[STORM_CASES] = {
+    "clean", "chatter", "glitch", "allpins", "shortcar", "revpass"
+  };
+  return id < STORM_CASES ? names[id] : "?";
+}
+
+
+/*---------------------------------------------------------------------------
+** SCRIPT BUILDING
+**
+** Sensors 0..3 are mainIn, mainOut, revIn, revOut.  An outbound train
+** blocks the Out beam first.
+**--------------------------------------------------------------------------*/
+void sensorStorm::add( bcsjTime64 at, uint8_t sensor, uint8_t level )
+{
+  if (count < STORM_MAX_EDGES) {
+    edges[count].at      = at;
+    edges[count].sensor  = sensor;
+    edges[count].level   = level;
+    edges[count].settled = false;
+    count++;
+  }
+}
+
+void sensorStorm::chatter( bcsjTime64 at, uint8_t sensor, uint8_t level )
+{
+  for (uint8_t i = 0; i <= STORM_CHATTER_EDGES; i++) {   // ends on level at at
+    bcsjTime64 back = (bcsjTime64)(STORM_CHATTER_EDGES - i) * STORM_CHATTER_STEP;
+    add(at - back, sensor, (i & 1) ? !level : level);
+  }
+}
+
+void sensorStorm::passBy( bcsjTime64 at, uint8_t first, uint8_t second, bcsjTime64 gap, bcsjTime64 body )
+{
+  add(at,              first,  LOW);
+  add(at + gap,        second, LOW);
+  add(at + body,       first,  HIGH);
+  add(at + body + gap, second, HIGH);
+}
+
+void sensorStorm::sortAndSettle( void )
+{
+  for (uint8_t i = 1; i < count; i++) {    // insertion sort, scripts are short
+    stormEdge edge = edges[i];
+    int8_t j = i - 1;
+    while (j >= 0 && edges[j].at > edge.at) {
+      edges[j + 1] = edges[j];
+      j--;
+    }
+    edges[j + 1] = edge;
+  }
+  uint8_t last[STORM_SENSORS] = {HIGH, HIGH, HIGH, HIGH};
+  for (uint8_t i = 0; i < count; i++) {
+    bcsjTime64 holds = MAXTIMEVALUE;
+    for (uint8_t j = i + 1; j < count; j++) {
+      if (edges[j].sensor == edges[i].sensor) {
+        holds = edges[j].at - edges[i].at;
+        break;
+      }
+    }
+    if (holds >= stable && edges[i].level != last[edges[i].sensor]) {
+      edges[i].settled = true;
+      last[edges[i].sensor] = edges[i].level;
+      result.settled++;
+    }
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** BEGIN
+**
+** Cases start 10 ms in, so a chatter burst before the first edge fits
+**--------------------------------------------------------------------------*/
+void sensorStorm::begin( uint8_t id, bcsjTime64 now, bcsjTime64 stableTime )
+{
+  bcsjTime64 t0 = bcsjMillis(10);
+  count  = 0;
+  stable = stableTime;
+  memset(&result, 0, sizeof(result));
+
+  if (id == STORM_CLEAN) {
+    passBy(t0, 1, 0, bcsjMillis(50), bcsjMillis(300));
+  }
+  else if (id == STORM_CHATTER) {
+    chatter(t0,                     1, LOW);
+    chatter(t0 + bcsjMillis(50),    0, LOW);
+    chatter(t0 + bcsjMillis(300),   1, HIGH);
+    chatter(t0 + bcsjMillis(350),   0, HIGH);
+  }
+  else if (id == STORM_GLITCH) {
+    for (uint8_t sensor = 0; sensor < STORM_SENSORS; sensor++) {
+      bcsjTime64 at = t0 + sensor * bcsjMillis(50);
+      add(at, sensor, LOW);
+      add(at + STORM_GLITCH_TIME, sensor, HIGH);
+    }
+  }
+  else if (id == STORM_ALLPINS) {
+    for (uint8_t sensor = 0; sensor < STORM_SENSORS; sensor++) {
+      add(t0, sensor, LOW);
+      add(t0 + bcsjMillis(100), sensor, HIGH);
+    }
+  }
+  else if (id == STORM_SHORTCAR) {          // clears the first beam before
+    add(t0,                    1, LOW);     // reaching the second
+    add(t0 + bcsjMillis(100),  1, HIGH);
+    add(t0 + bcsjMillis(150),  0, LOW);
+    add(t0 + bcsjMillis(250),  0, HIGH);
+  }
+  else if (id == STORM_REVPASS) {           // inbound on the reverse loop pair
+    passBy(t0, 2, 3, bcsjMillis(50), bcsjMillis(300));
+  }
+
+  sortAndSettle();
+  for (uint8_t sensor = 0; sensor < STORM_SENSORS; sensor++) {
+    levels[sensor]  = HIGH;
+    pending[sensor] = -1;
+  }
+  seenBlocked = 0;
+  played      = 0;
+  start       = now;
+  playing     = true;
+}
+
+
+/*---------------------------------------------------------------------------
+** PLAY
+**--------------------------------------------------------------------------*/
+boolean sensorStorm::active( void )
+{
+  return playing;
+}
+
+boolean sensorStorm::done( bcsjTime64 now )
+{
+  if (played < count) {
+    return false;
+  }
+  bcsjTime64 last = count ? edges[count - 1].at : 0;
+  return now - start >= last + STORM_SETTLE;
+}
+
+uint8_t sensorStorm::level( uint8_t sensor, bcsjTime64 now )
+{
+  while (played < count && start + edges[played].at <= now) {
+    stormEdge &edge = edges[played];
+    levels[edge.sensor] = edge.level;
+    if (edge.settled) {
+      pending[edge.sensor] = played;        // a later settled edge replaces it
+    }                                       // unseen, end() counts that as missed
+    played++;
+  }
+  return levels[sensor];
+}
+
+
+/*---------------------------------------------------------------------------
+** OBSERVE
+**
+** Called after each pass of the sensor readers with the report bits
+**--------------------------------------------------------------------------*/
+void sensorStorm::observe( uint8_t blocked, bcsjTime64 now )
+{
+  result.passes++;
+  result.elapsed = now - start;
+  uint8_t changed = blocked ^ seenBlocked;
+  seenBlocked = blocked;
+  for (uint8_t sensor = 0; sensor < STORM_SENSORS; sensor++) {
+    if (!bitRead(changed, sensor)) {
+      continue;
+    }
+    uint8_t level = bitRead(blocked, sensor) ? LOW : HIGH;
+    int16_t slot  = pending[sensor];
+    if (slot >= 0 && edges[slot].level == level) {
+      bcsjTime64 latency = now - (start + edges[slot].at);
+      result.seen++;
+      result.latencySum += latency;
+      if (latency > result.latencyMax) {
+        result.latencyMax = latency;
+      }
+      pending[sensor] = -1;
+    }
+    else {
+      result.spurious++;
+    }
+  }
+}
+
+void sensorStorm::end( void )
+{
+  playing = false;
+  result.missed = result.settled > result.seen ? result.settled - result.seen : 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** STORM DEBOUNCER
+**--------------------------------------------------------------------------*/
+bool stormBounce::readCurrentState()
+{
+  if (storm.active()) {
+    return storm.level(slot, bcsjNow());
+  }
+  return Bounce::readCurrentState();
+}
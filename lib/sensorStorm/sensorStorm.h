@@ -0,0 +1,102 @@
+/*
+  sensorStorm.h - pathological sensor input for the latency benchmark
+
+  Each case is a short script of beam edges on the four sensor inputs
+  (mainIn, mainOut, revIn, revOut).  While a case plays, stormBounce
+  debouncers hand the firmware the scripted level instead of the pin, so
+  the real readMainSens()/readRevSens() run on it, on the board or on the
+  host.  observe() is given the sensor report bits after every pass and
+  matches their changes to the edges that should survive debouncing:
+
+    seen      a settled edge showed up in the report, latency is from the
+              edge to the pass that saw it
+    missed    a settled edge never showed up
+    spurious  the report changed where no settled edge was
+
+  An edge is settled when its level holds for stableTime or more.
+*/
+
+
+#ifndef __SENSORSTORM_H__
+#define __SENSORSTORM_H__
+
+#include "bcsjTimer.h"
+#include <Bounce2.h>
+
+#define STORM_SENSORS    4                 // mainIn, mainOut, revIn, revOut
+#define STORM_MAX_EDGES  96
+
+enum stormCaseId : uint8_t {STORM_CLEAN, STORM_CHATTER, STORM_GLITCH, STORM_ALLPINS,
+                            STORM_SHORTCAR, STORM_REVPASS, STORM_CASES};
+
+struct stormResult
+{
+  uint16_t   settled;                      // edges that should reach the report
+  uint16_t   seen;
+  uint16_t   missed;
+  uint16_t   spurious;
+  bcsjTime64 latencyMax;
+  bcsjTime64 latencySum;
+  uint32_t   passes;                       // observe() calls
+  bcsjTime64 elapsed;                      // first edge to last pass
+};
+
+class sensorStorm
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+             sensorStorm();                // constructor
+    void     begin( uint8_t id, bcsjTime64 now, bcsjTime64 stableTime ); // build and start a case
+    boolean  active( void );               // a case is playing
+    boolean  done( bcsjTime64 now );       // last edge played and settled
+    uint8_t  level( uint8_t sensor, bcsjTime64 now );   // scripted pin level
+    void     observe( uint8_t blocked, bcsjTime64 now ); // report bits: 1 = beam blocked
+    void     end( void );                  // stop playing, fill in missed
+    const char *name( uint8_t id );
+
+    stormResult result;
+
+
+  private:
+    struct stormEdge {
+      bcsjTime64 at;                       // from the start of the case
+      uint8_t    sensor;
+      uint8_t    level;
+      boolean    settled;
+    };
+    stormEdge  edges[STORM_MAX_EDGES];     // in time order
+    uint8_t    count;
+    uint8_t    played;                     // edges already on the inputs
+    boolean    playing;
+    bcsjTime64 start;
+    bcsjTime64 stable;
+    uint8_t    levels[STORM_SENSORS];      // scripted input now
+    uint8_t    seenBlocked;                // report bits at the last pass
+    int16_t    pending[STORM_SENSORS];     // settled edge not seen yet, -1 if none
+
+    void     add( bcsjTime64 at, uint8_t sensor, uint8_t level );
+    void     chatter( bcsjTime64 at, uint8_t sensor, uint8_t level );
+    void     passBy( bcsjTime64 at, uint8_t first, uint8_t second, bcsjTime64 gap, bcsjTime64 body );
+    void     sortAndSettle( void );
+
+};
+
+extern sensorStorm storm;
+
+//
+// Debouncer that reads the storm script while a case is playing
+//
+class stormBounce : public Bounce
+{
+  public:
+             stormBounce( uint8_t sensor ) : slot(sensor) {}
+
+  protected:
+    bool     readCurrentState() override;
+    uint8_t  slot;
+};
+
+#endif
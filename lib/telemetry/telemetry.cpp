@@ -0,0 +1,240 @@
+#include "telemetry.h"
+#include "bcsjTimer.h"
+
+telemetryStream telemetry;
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+telemetryStream::telemetryStream(void)
+{
+  out      = NULL;
+  head     = 0;
+  tail     = 0;
+  lost     = 0;
+  frameLen = 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** BEGIN
+**--------------------------------------------------------------------------*/
+void telemetryStream::begin( HardwareSerial &port )
+{
+  out  = &port;
+  head = 0;
+  tail = 0;
+  lost = 0;
+}
+
+
+/*---------------------------------------------------------------------------
+** FRAME BUILDING
+**
+** type, ms since boot, payload; send() adds the CRC-8 (poly 0x07).
+**--------------------------------------------------------------------------*/
+void telemetryStream::add( uint8_t b )
+{
+  if (frameLen < TELEMETRY_FRAME - 1) {    // room for the CRC
+    frame[frameLen++] = b;
+  }
+}
+
+void telemetryStream::add16( uint16_t v )
+{
+  add(v);
+  add(v >> 8);
+}
+
+void telemetryStream::add32( uint32_t v )
+{
+  add16(v);
+  add16(v >> 16);
+}
+
+void telemetryStream::start( uint8_t type )
+{
+  frameLen = 0;
+  add(type);
+  add32((uint32_t)(bcsjNow() / 1000ULL));
+}
+
+static uint8_t crc8( const uint8_t *data, uint8_t len )
+{
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+
+/*---------------------------------------------------------------------------
+** SEND
+**
+** COBS: every zero is replaced by the distance to the next one, with a
+** code byte in front of each run of at most 254 others.  The frame is
+** encoded whole before anything goes into the ring, so a frame is either
+** queued complete or not at all.
+**--------------------------------------------------------------------------*/
+static uint8_t cobs( const uint8_t *in, uint8_t len, uint8_t *enc )
+{
+  uint8_t n    = 1;
+  uint8_t code = 0;                        // where the current run's code goes
+  for (uint8_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      enc[code] = n - code;
+      code = n++;
+    }
+    else {
+      enc[n++] = in[i];
+      if (n - code == 0xFF) {
+        enc[code] = 0xFF;
+        code = n++;
+      }
+    }
+  }
+  enc[code] = n - code;
+  return n;
+}
+
+static boolean queue( uint8_t *ring, uint16_t &head, uint16_t tail,
+                      const uint8_t *raw, uint8_t len )
+{
+  uint8_t enc[TELEMETRY_FRAME + 2];
+  uint8_t n = cobs(raw, len, enc);
+  if ((uint16_t)(TELEMETRY_RING - (uint16_t)(head - tail)) < n + 2) {
+    return false;
+  }
+  ring[head++ & (TELEMETRY_RING - 1)] = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    ring[head++ & (TELEMETRY_RING - 1)] = enc[i];
+  }
+  ring[head++ & (TELEMETRY_RING - 1)] = 0;
+  return true;
+}
+
+boolean telemetryStream::send( void )
+{
+  frame[frameLen] = crc8(frame, frameLen);
+  uint8_t len = frameLen + 1;
+
+  if (lost) {                              // say what was lost first, if it fits
+    uint8_t raw[8];
+    uint32_t ms = (uint32_t)(bcsjNow() / 1000ULL);
+    raw[0] = LOG_EV_DROPPED;
+    raw[1] = ms;       raw[2] = ms >> 8;
+    raw[3] = ms >> 16; raw[4] = ms >> 24;
+    raw[5] = lost;     raw[6] = lost >> 8;
+    raw[7] = crc8(raw, 7);
+    if (queue(ring, head, tail, raw, 8)) {
+      lost = 0;
+    }
+  }
+  if (lost || !queue(ring, head, tail, frame, len)) {
+    if (lost < 0xFFFF) lost++;
+    return false;
+  }
+  pump();
+  return true;
+}
+
+
+/*---------------------------------------------------------------------------
+** EVENTS
+**--------------------------------------------------------------------------*/
+void telemetryStream::text( uint8_t level, const char *msg )
+{
+  start(LOG_EV_TEXT);
+  add(level);
+  for (uint8_t i = 0; i < TELEMETRY_TEXT && msg[i]; i++) {
+    add(msg[i]);
+  }
+  send();
+}
+
+void telemetryStream::mode( uint8_t from, uint8_t to )
+{
+  start(LOG_EV_MODE);
+  add(from);
+  add(to);
+  send();
+}
+
+void telemetryStream::sensor( uint8_t pair, uint8_t report, uint8_t direction, uint8_t passBy )
+{
+  start(LOG_EV_SENSOR);
+  add(pair);
+  add(report);
+  add(direction);
+  add(passBy);
+  send();
+}
+
+void telemetryStream::route( uint16_t track, uint16_t word )
+{
+  start(LOG_EV_ROUTE);
+  add16(track);
+  add16(word);
+  send();
+}
+
+void telemetryStream::timing( uint8_t id, uint32_t us )
+{
+  start(LOG_EV_TIMING);
+  add(id);
+  add32(us);
+  send();
+}
+
+
+/*---------------------------------------------------------------------------
+** PUMP
+**
+** availableForWrite() is what the UART driver buffer takes without
+** waiting; the rest stays in the ring for the next call.
+**--------------------------------------------------------------------------*/
+void telemetryStream::pump( void )
+{
+  if (out == NULL) {
+    return;
+  }
+  int room = out->availableForWrite();
+  while (room > 0 && tail != head) {
+    uint16_t at  = tail & (TELEMETRY_RING - 1);
+    uint16_t run = head - tail;
+    if (run > TELEMETRY_RING - at) run = TELEMETRY_RING - at;
+    if (run > room)                run = room;
+    out->write(&ring[at], run);
+    tail += run;
+    room -= run;
+  }
+}
+
+void telemetryStream::flush( void )
+{
+  if (out == NULL) {
+    return;
+  }
+  while (tail != head) {
+    uint16_t at  = tail & (TELEMETRY_RING - 1);
+    uint16_t run = head - tail;
+    if (run > TELEMETRY_RING - at) run = TELEMETRY_RING - at;
+    out->write(&ring[at], run);
+    tail += run;
+  }
+}
+
+uint16_t telemetryStream::pending( void )
+{
+  return head - tail;
+}
+
+uint16_t telemetryStream::dropped( void )
+{
+  return lost;
+}
@@ -0,0 +1,137 @@
+/*
+  telemetry.h - log levels and the binary telemetry stream
+
+  Logging goes through the LOG_ macros below.  LOG_LEVEL picks at compile
+  time what is built in; a macro above the level expands to nothing and
+  its arguments are not evaluated, so a LOG_NONE build carries no logging
+  code at all.  LOG_NONE is the default: frames on the USB port would
+  garble the operator's serial monitor, so a build asks for them.
+
+    LOG_E/W/I/D(text)                 message at that level
+    LOG_MODE(from, to)                state machine change       INFO
+    LOG_ROUTE(track, word)            route word latched         INFO
+    LOG_TIMING(id, us)                a timing sample, LOG_T_    INFO
+    LOG_SENSOR(pair, report, direction, passBy)                  DEBUG
+
+  Each event is one frame: type, ms since boot, payload and a CRC-8,
+  COBS encoded so the frame holds no zero byte, with a zero before and
+  after it.  Frames go into a TX ring and pump() hands the UART only what
+  its buffer takes, so logging never blocks the loop.  A frame that does
+  not fit in the ring is dropped and counted; the count goes out in a
+  LOG_EV_DROPPED frame once there is room again.
+
+  Text the firmware prints straight to Serial (bench results, the input
+  trace) sits between frames.  tools/yardTelemetry.py decodes the frames
+  and passes the text through.
+*/
+
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include "Arduino.h"
+
+#define LOG_NONE   0
+#define LOG_ERROR  1
+#define LOG_WARN   2
+#define LOG_INFO   3
+#define LOG_DEBUG  4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL  LOG_NONE               // the USB port stays plain text for the operator
+#endif
+
+#define TELEMETRY_RING     512             // bytes, must be a power of two
+#define TELEMETRY_FRAME    64              // largest frame before encoding
+#define TELEMETRY_TEXT     48              // longest message kept
+
+enum logEvent : uint8_t {LOG_EV_TEXT = 1, LOG_EV_MODE, LOG_EV_SENSOR, LOG_EV_ROUTE,
+                         LOG_EV_TIMING, LOG_EV_DROPPED};
+
+//---LOG_TIMING ids, tools/yardTelemetry.py has the same list
+enum logTiming : uint8_t {LOG_T_BOOT_SAMPLE, LOG_T_FLASH_COMMIT, LOG_T_IDLE_WAKE,
+                          LOG_T_POWER_TRIP};
+
+class telemetryStream
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+             telemetryStream();            // constructor
+    void     begin( HardwareSerial &port ); // empty the ring, send to port
+    void     text( uint8_t level, const char *msg );
+    void     mode( uint8_t from, uint8_t to );
+    void     sensor( uint8_t pair, uint8_t report, uint8_t direction, uint8_t passBy );
+    void     route( uint16_t track, uint16_t word );
+    void     timing( uint8_t id, uint32_t us );
+    void     pump( void );                 // as much of the ring as the UART takes
+    void     flush( void );                // all of it, blocking
+    uint16_t pending( void );              // bytes in the ring
+    uint16_t dropped( void );              // frames lost since the last report
+
+
+  private:
+    HardwareSerial *out;
+    uint8_t    ring[TELEMETRY_RING];
+    uint16_t   head;                       // free running, masked on use
+    uint16_t   tail;
+    uint16_t   lost;
+
+    uint8_t    frame[TELEMETRY_FRAME];
+    uint8_t    frameLen;
+    void       start( uint8_t type );
+    void       add( uint8_t b );
+    void       add16( uint16_t v );
+    void       add32( uint32_t v );
+    boolean    send( void );               // encode into the ring, false if no room
+
+};
+
+extern telemetryStream telemetry;
+
+#if LOG_LEVEL > LOG_NONE
+#define LOG_BEGIN(port)  telemetry.begin(port)
+#define LOG_PUMP()       telemetry.pump()
+#define LOG_FLUSH()      telemetry.flush()
+#else
+#define LOG_BEGIN(port)  ((void)0)
+#define LOG_PUMP()       ((void)0)
+#define LOG_FLUSH()      ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_ERROR
+#define LOG_E(msg)       telemetry.text(LOG_ERROR, msg)
+#else
+#define LOG_E(msg)       ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_WARN
+#define LOG_W(msg)       telemetry.text(LOG_WARN, msg)
+#else
+#define LOG_W(msg)       ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_INFO
+#define LOG_I(msg)                  telemetry.text(LOG_INFO, msg)
+#define LOG_MODE(from, to)          telemetry.mode(from, to)
+#define LOG_ROUTE(track, word)      telemetry.route(track, word)
+#define LOG_TIMING(id, us)          telemetry.timing(id, us)
+#else
+#define LOG_I(msg)                  ((void)0)
+#define LOG_MODE(from, to)          ((void)0)
+#define LOG_ROUTE(track, word)      ((void)0)
+#define LOG_TIMING(id, us)          ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_DEBUG
+#define LOG_D(msg)                  telemetry.text(LOG_DEBUG, msg)
+#define LOG_SENSOR(pair, report, direction, passBy) \
+                                    telemetry.sensor(pair, report, direction, passBy)
+#else
+#define LOG_D(msg)                  ((void)0)
+#define LOG_SENSOR(pair, report, direction, passBy)  ((void)0)
+#endif
+
+#endif
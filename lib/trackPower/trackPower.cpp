@@ -0,0 +1,240 @@
+#include "trackPower.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include "esp_timer.h"
+static portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+#define POWER_LOCK()    portENTER_CRITICAL(&powerMux)
+#define POWER_UNLOCK()  portEXIT_CRITICAL(&powerMux)
+#else
+#define POWER_LOCK()
+#define POWER_UNLOCK()
+#endif
+
+trackPowerStage powerStage;
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+trackPowerStage::trackPowerStage(void)
+{
+  gate       = 0xFF;
+  sense      = 0xFF;
+  commanded  = LOW;
+  dutyNow    = 0;
+  reason     = TRIP_NONE;
+  over       = 0;
+  overSince  = 0;
+  rampStart  = 0;
+  lastTripMa = 0;
+  lastTripUs = 0;
+  tripCount  = 0;
+  onTrip     = NULL;
+#if defined(ARDUINO_ARCH_ESP32)
+  timer      = NULL;
+#endif
+}
+
+
+/*---------------------------------------------------------------------------
+** BEGIN
+**
+** The gate is held off before the pin becomes an output.  ADC_11db takes
+** the sense amplifier's whole 0..3.1 V.
+**--------------------------------------------------------------------------*/
+void trackPowerStage::begin( uint8_t gatePin, uint8_t sensePin )
+{
+  gate      = gatePin;
+  sense     = sensePin;
+  commanded = LOW;
+  reason    = TRIP_NONE;
+  over      = 0;
+#if defined(ARDUINO_ARCH_ESP32)
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+  ledcAttach(gate, POWER_PWM_HZ, POWER_PWM_BITS);
+#else
+  ledcSetup(POWER_LEDC_CH, POWER_PWM_HZ, POWER_PWM_BITS);
+  ledcAttachPin(gate, POWER_LEDC_CH);
+#endif
+  analogSetPinAttenuation(sense, ADC_11db);
+  if (timer == NULL) {
+    esp_timer_create_args_t args = {};
+    args.callback = poll;
+    args.arg      = this;
+    args.name     = "power";
+    esp_timer_create(&args, (esp_timer_handle_t *)&timer);
+  }
+#endif
+  dutyNow = 0;
+  drive();
+}
+
+
+/*---------------------------------------------------------------------------
+** GATE
+**
+** dutyNow is decided under the lock, the LEDC driver is called after it
+** is released: ledcWrite() takes the driver's own lock and may wait.
+** When set() and the timer task both write, whichever finds dutyNow
+** changed behind its back writes again, so the last decision wins.
+**--------------------------------------------------------------------------*/
+void trackPowerStage::drive( void )
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  uint8_t d;
+  boolean stale;
+  do {
+    POWER_LOCK();
+    d = dutyNow;
+    POWER_UNLOCK();
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    ledcWrite(gate, d);
+#else
+    ledcWrite(POWER_LEDC_CH, d);
+#endif
+    POWER_LOCK();
+    stale = (d != dutyNow);
+    POWER_UNLOCK();
+  } while (stale);
+#endif
+}
+
+
+/*---------------------------------------------------------------------------
+** SAMPLING TIMER
+**
+** esp_timer callbacks run in the esp_timer task, not in an ISR, so the
+** ADC driver may be used.  Starting and stopping take the timer's own
+** lock and stay outside POWER_LOCK.
+**--------------------------------------------------------------------------*/
+void trackPowerStage::poll( void *arg )
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  trackPowerStage *stage = (trackPowerStage *)arg;
+  stage->sample(analogReadMilliVolts(stage->sense), bcsjNow());
+#else
+  (void)arg;
+#endif
+}
+
+void trackPowerStage::startSampling( void )
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (timer != NULL) {
+    esp_timer_stop((esp_timer_handle_t)timer);    // not running is fine
+    esp_timer_start_periodic((esp_timer_handle_t)timer, POWER_SAMPLE_US);
+  }
+#endif
+}
+
+void trackPowerStage::stopSampling( void )
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (timer != NULL) {
+    esp_timer_stop((esp_timer_handle_t)timer);
+  }
+#endif
+}
+
+
+/*---------------------------------------------------------------------------
+** SET
+**--------------------------------------------------------------------------*/
+void trackPowerStage::set( uint8_t level )
+{
+  level = level ? HIGH : LOW;
+  if (level == commanded) {
+    return;
+  }
+  POWER_LOCK();
+  commanded = level;
+  if (level == HIGH) {
+    reason    = TRIP_NONE;
+    over      = 0;
+    rampStart = bcsjNow();
+  }
+  dutyNow = 0;                             // the ramp starts from off
+  POWER_UNLOCK();
+  drive();
+  if (level == HIGH) startSampling();
+  else               stopSampling();
+}
+
+
+/*---------------------------------------------------------------------------
+** SAMPLE
+**
+** A reading over the limit that is not followed by another is taken for
+** noise or the inrush of a sound decoder and forgotten.  Latency is from
+** the first reading over the limit; the short itself began at most one
+** sample period before that.
+**--------------------------------------------------------------------------*/
+void trackPowerStage::sample( uint16_t mv, bcsjTime64 now )
+{
+  boolean justTripped = false;
+  POWER_LOCK();
+  uint8_t was = dutyNow;
+  if (commanded == HIGH && reason == TRIP_NONE) {
+    uint32_t ma = (uint32_t)mv * 1000UL / POWER_MV_PER_A;
+    if (ma > POWER_LIMIT_MA) {
+      if (over == 0) overSince = now;
+      if (++over >= POWER_CONFIRM) {
+        dutyNow     = 0;
+        reason      = TRIP_OVERCURRENT;
+        lastTripMa  = ma > 0xFFFF ? 0xFFFF : ma;
+        lastTripUs  = (uint32_t)(now - overSince);
+        justTripped = true;
+        if (tripCount < 0xFFFF) tripCount++;
+      }
+    }
+    else {
+      over = 0;
+    }
+    if (reason == TRIP_NONE && dutyNow < POWER_DUTY_FULL) {
+      bcsjTime64 ramp = bcsjMillis(POWER_RAMP_MS);
+      bcsjTime64 done = now - rampStart;
+      dutyNow = (done >= ramp) ? POWER_DUTY_FULL : (uint8_t)(done * POWER_DUTY_FULL / ramp);
+    }
+  }
+  boolean changed = (dutyNow != was);
+  POWER_UNLOCK();
+  if (changed) drive();
+  if (justTripped) {
+    stopSampling();
+    if (onTrip != NULL) onTrip();
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** STATUS
+**--------------------------------------------------------------------------*/
+uint8_t trackPowerStage::level( void )
+{
+  return commanded;
+}
+
+uint8_t trackPowerStage::duty( void )
+{
+  return dutyNow;
+}
+
+uint8_t trackPowerStage::tripped( void )
+{
+  return reason;
+}
+
+uint16_t trackPowerStage::tripMa( void )
+{
+  return lastTripMa;
+}
+
+uint32_t trackPowerStage::tripUs( void )
+{
+  return lastTripUs;
+}
+
+uint16_t trackPowerStage::trips( void )
+{
+  return tripCount;
+}
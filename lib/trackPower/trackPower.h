@@ -0,0 +1,99 @@
+/*
+  trackPower.h - track power through a MOSFET, soft start and overcurrent trip
+
+  Built in with POWER_STAGE=1 in place of the relay on trackPowerLED_PIN.
+  The gate is driven by LEDC PWM.  set(HIGH) ramps the duty from zero to
+  full over POWER_RAMP_MS, so the decoders' capacitors charge without the
+  inrush looking like a short; set(LOW) switches the gate off at once.
+
+  While the gate is on, an esp_timer reads the current-sense amplifier
+  every POWER_SAMPLE_US with analogReadMilliVolts() and hands the reading
+  to sample(), which also steps the ramp.  POWER_CONFIRM readings in a row
+  over POWER_LIMIT_MA switch the gate off from the timer task itself,
+  without waiting for loop(): with the defaults a short is off within
+  2 x 250 us of its first reading.  The stage stays off and keeps the
+  reason until the next set(HIGH); the firmware polls tripped().
+
+  The timer only runs while the gate is on, so STAND_BY with track power
+  off still blocks, and sleeps on a core built with power management.  On the host nothing is driven: the
+  tests call sample() with their own readings and look at duty().
+*/
+
+
+#ifndef __TRACKPOWER_H__
+#define __TRACKPOWER_H__
+
+#include "Arduino.h"
+#include "bcsjTimer.h"
+
+#ifndef POWER_LIMIT_MA
+#define POWER_LIMIT_MA    3000             // trip above this, mA
+#endif
+#ifndef POWER_MV_PER_A
+#define POWER_MV_PER_A    500              // sense resistor times amplifier gain
+#endif
+#ifndef POWER_CONFIRM
+#define POWER_CONFIRM     2                // readings in a row over the limit
+#endif
+#ifndef POWER_SAMPLE_US
+#define POWER_SAMPLE_US   250
+#endif
+#ifndef POWER_RAMP_MS
+#define POWER_RAMP_MS     50               // zero to full duty
+#endif
+
+#define POWER_PWM_HZ      20000            // above hearing, the motors do not sing
+#define POWER_PWM_BITS    8
+#define POWER_DUTY_FULL   255
+#define POWER_LEDC_CH     0
+
+enum powerTrip : uint8_t {TRIP_NONE, TRIP_OVERCURRENT};
+
+class trackPowerStage
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+             trackPowerStage();            // constructor
+    void     begin( uint8_t gatePin, uint8_t sensePin ); // gate off, timer made
+    void     set( uint8_t level );         // HIGH ramps up and clears a trip, LOW cuts
+    void     sample( uint16_t mv, bcsjTime64 now ); // one sense reading
+    uint8_t  level( void );                // last set()
+    uint8_t  duty( void );                 // gate duty now, 0..POWER_DUTY_FULL
+    uint8_t  tripped( void );              // TRIP_ reason, TRIP_NONE while allowed on
+    uint16_t tripMa( void );               // reading that tripped it
+    uint32_t tripUs( void );               // first reading over the limit to gate off
+    uint16_t trips( void );                // since boot
+
+    void   (*onTrip)( void );              // called from the timer task after a trip
+
+
+  private:
+    uint8_t    gate;
+    uint8_t    sense;
+    uint8_t    commanded;
+    uint8_t    dutyNow;
+    uint8_t    reason;
+    uint8_t    over;                       // readings in a row over the limit
+    bcsjTime64 overSince;
+    bcsjTime64 rampStart;
+    uint16_t   lastTripMa;
+    uint32_t   lastTripUs;
+    uint16_t   tripCount;
+#if defined(ARDUINO_ARCH_ESP32)
+    void      *timer;                      // esp_timer_handle_t
+#endif
+
+    void     drive( void );                // write dutyNow to the gate, outside the lock
+    void     startSampling( void );
+    void     stopSampling( void );
+
+    static void poll( void *arg );
+
+};
+
+extern trackPowerStage powerStage;
+
+#endif
@@ -0,0 +1,169 @@
+
+#include "yardConfig.h"
+#include <stddef.h>
+#include <nvs.h>
+
+
+/*---------------------------------------------------------------------------
+** DEFAULTS
+**
+** Settings for a blank board: Test yard, 1 minute everywhere
+**--------------------------------------------------------------------------*/
+void configDefaults( yardConfig &cfg )
+{
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.crntMap = 4;
+  for (uint8_t yard = 0; yard < YARD_CONFIG_YARDS; yard++) {
+    cfg.yardDelay[yard] = 1;
+  }
+  cfg.tortoiseMs       = 3000;
+  cfg.debounceMs       = 5;
+  cfg.screenTimeoutSec = 60;
+  cfg.preAlignMs       = 2000;
+  cfg.flags            = 0;               // automatic moves are opted into
+  cfg.autoRoutePolicy  = 0;
+  cfg.ladderClearSec   = 15;
+  configSeal(cfg);
+}
+
+
+/*---------------------------------------------------------------------------
+** MIGRATE
+**
+** Carries over the old EEPROM bytes if they are in range.  Blank flash
+** reads 255 and is left at the default; the old firmware took up to 60
+** minutes.
+**--------------------------------------------------------------------------*/
+void configMigrate( yardConfig &cfg, uint8_t oldMap, uint8_t oldDelay )
+{
+  if (oldMap < YARD_CONFIG_YARDS) {
+    cfg.crntMap = oldMap;
+    if (oldDelay <= 60) {
+      cfg.yardDelay[oldMap] = oldDelay;
+    }
+  }
+  configSeal(cfg);
+}
+
+
+/*---------------------------------------------------------------------------
+** SEAL
+**
+**--------------------------------------------------------------------------*/
+void configSeal( yardConfig &cfg )
+{
+  cfg.magic   = YARD_CONFIG_MAGIC;
+  cfg.version = YARD_CONFIG_VERSION;
+  cfg.crc     = configCrc(&cfg, offsetof(yardConfig, crc));
+}
+
+
+/*---------------------------------------------------------------------------
+** VALID
+**
+** Returns true if the record is ours, this version, intact and in range
+**--------------------------------------------------------------------------*/
+boolean configValid( const yardConfig &cfg )
+{
+  if (cfg.magic != YARD_CONFIG_MAGIC || cfg.version != YARD_CONFIG_VERSION) {
+    return false;
+  }
+  if (cfg.crc != configCrc(&cfg, offsetof(yardConfig, crc))) {
+    return false;
+  }
+  return cfg.crntMap < YARD_CONFIG_YARDS && cfg.tortoiseMs > 0 &&
+         cfg.autoRoutePolicy < AUTO_POLICIES;
+}
+
+
+/*---------------------------------------------------------------------------
+** CRC
+**
+** CRC-16/CCITT-FALSE, bitwise - the record is read once per boot
+**--------------------------------------------------------------------------*/
+uint16_t configCrc( const void *data, size_t len )
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)(*bytes++) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+
+/*---------------------------------------------------------------------------
+** LOAD
+**
+** Returns true if a valid record was read into cfg
+**--------------------------------------------------------------------------*/
+boolean configLoad( yardConfig &cfg )
+{
+  if (!nvsReadBlob(YARD_CONFIG_KEY, &cfg, sizeof(cfg))) {
+    return false;
+  }
+  return configValid(cfg);
+}
+
+
+/*---------------------------------------------------------------------------
+** SAVE
+**
+**--------------------------------------------------------------------------*/
+boolean configSave( yardConfig &cfg )
+{
+  configSeal(cfg);
+  return nvsWriteBlob(YARD_CONFIG_KEY, &cfg, sizeof(cfg));
+}
+
+
+/*---------------------------------------------------------------------------
+** NVS BLOB READ / WRITE
+**
+** A blob of a different size than asked for counts as missing
+**--------------------------------------------------------------------------*/
+boolean nvsReadBlob( const char *key, void *buf, size_t len )
+{
+  nvs_handle_t handle;
+  if (nvs_open(YARD_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+    return false;
+  }
+  size_t stored = len;
+  esp_err_t err = nvs_get_blob(handle, key, buf, &stored);
+  nvs_close(handle);
+  return err == ESP_OK && stored == len;
+}
+
+boolean nvsWriteBlob( const char *key, const void *buf, size_t len )
+{
+  nvsBlob blob = {key, buf, len};
+  return nvsWriteBlobs(&blob, 1);
+}
+
+
+/*---------------------------------------------------------------------------
+** NVS BATCH WRITE
+**
+** Sets every blob, then commits once.  Each flash erase/write stalls both
+** cores with the cache off, so callers should gather their changes and
+** write them together.
+**--------------------------------------------------------------------------*/
+boolean nvsWriteBlobs( const nvsBlob *blobs, uint8_t count )
+{
+  nvs_handle_t handle;
+  if (nvs_open(YARD_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+    return false;
+  }
+  esp_err_t err = ESP_OK;
+  for (uint8_t i = 0; i < count && err == ESP_OK; i++) {
+    err = nvs_set_blob(handle, blobs[i].key, blobs[i].buf, blobs[i].len);
+  }
+  if (err == ESP_OK) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  return err == ESP_OK;
+}
@@ -0,0 +1,65 @@
+/*
+  yardConfig.h - board settings kept as one CRC checked record in NVS
+
+  Every tunable lives in a single packed yardConfig blob, read once at boot.
+  A blob with the wrong magic, version, size or CRC is ignored and the
+  caller falls back to defaults, migrating the two bytes the old firmware
+  kept in EEPROM (yard map at 0, delay minutes at 1) when they make sense.
+*/
+
+
+#ifndef __YARDCONFIG_H__
+#define __YARDCONFIG_H__
+
+#include "Arduino.h"
+
+#define YARD_CONFIG_MAGIC    0x4359        // "YC"
+#define YARD_CONFIG_VERSION  1
+#define YARD_CONFIG_YARDS    8             // entries in mapData[]
+#define YARD_NVS_NAMESPACE   "yard"
+#define YARD_CONFIG_KEY      "cfg"
+
+//---yardConfig.flags
+#define CFG_PREALIGN      0x01
+#define CFG_AUTOROUTE     0x02
+#define CFG_AUTOREVLOOP   0x04
+#define CFG_SKIPOCCUPIED  0x08
+
+//---yardConfig.autoRoutePolicy
+enum autoPolicy : uint8_t {AUTO_NEAREST, AUTO_ROUNDROBIN, AUTO_POLICIES};
+
+struct __attribute__((packed)) yardConfig {
+  uint16_t magic;
+  uint8_t  version;
+  uint8_t  crntMap;                        // staging yard for this board
+  uint8_t  yardDelay[YARD_CONFIG_YARDS];   // track power minutes, per yard
+  uint16_t tortoiseMs;                     // Tortoise travel time
+  uint16_t debounceMs;                     // sensor debounce
+  uint16_t screenTimeoutSec;               // added to the power window for the OLED
+  uint16_t preAlignMs;                     // knob dwell before pre-align
+  uint8_t  flags;                          // CFG_ bits
+  uint8_t  autoRoutePolicy;                // autoPolicy
+  uint8_t  ladderClearSec;                 // inbound PassBy to off the ladder
+  uint16_t crc;                            // CRC-16/CCITT of all bytes above
+};
+
+void     configDefaults( yardConfig &cfg );
+void     configMigrate( yardConfig &cfg, uint8_t oldMap, uint8_t oldDelay );
+void     configSeal( yardConfig &cfg );    // stamp magic, version and crc
+boolean  configValid( const yardConfig &cfg );
+uint16_t configCrc( const void *data, size_t len );
+
+boolean  configLoad( yardConfig &cfg );    // one NVS read, false if missing or bad
+boolean  configSave( yardConfig &cfg );    // seal and write
+
+struct nvsBlob {
+  const char *key;
+  const void *buf;
+  size_t      len;
+};
+
+boolean  nvsReadBlob( const char *key, void *buf, size_t len );
+boolean  nvsWriteBlob( const char *key, const void *buf, size_t len );
+boolean  nvsWriteBlobs( const nvsBlob *blobs, uint8_t count );  // one commit for all
+
+#endif
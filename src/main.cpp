@@ -30,12 +30,54 @@
 //      user may single-click to select again for another "n" minutes 
 //      After the timer expires the system will return to the standby screen
 //      Setup Mode can be entered by holding the click knob for 6 seconds
+//      Pre-align (optional): if the knob rests on a track for "interval_PreAlign"
+//      with track power off and no sensor busy, the route is aligned ahead of
+//      the click so TRACK_SETUP only waits for any leftover Tortoise travel
+//      While browsing, the OLED previews how many turnouts the choice moves
+//      and the predicted alignment time against the latched route
+//      Occupancy: an inbound PassBy at mainSens marks the aligned track as 
+//      holding a train, an outbound PassBy clears it.  The map is kept in 
+//      NVS and drawn as a strip of boxes above the track number.  With 
+//      "skipOccupied" set the knob steps over occupied tracks while an 
+//      inbound train is at mainSens; departures can still pick them.
+//      Auto-route (optional): an INBOUND train at mainSens during STAND_BY is
+//      given an empty track picked by "autoRoutePolicy" and aligned as if 
+//      the operator had clicked.  Turning the knob first is a manual override.
+//      Reverse loop: in yards with a loop, an INBOUND train at revSens during
+//      STAND_BY, with mainSens clear, gets the "RL" route aligned and track 
+//      power on.  After the revSens PassBy, once the train is out through
+//      mainSens, the previous route and power return.  Off by default.
+//      Idle: in STAND_BY the loop blocks on a FreeRTOS event group raised by 
+//      pin interrupts from the encoder, switch and sensors, and the ESP32 
+//      drops into automatic light sleep with GPIO wakeup until one fires.
+//      The stock Arduino core is built without CONFIG_PM_ENABLE, so there
+//      the block only idles the cores; light sleep needs a core or an
+//      ESP-IDF build with power management and tickless idle turned on.
+//      Serial line: one command per line on the USB port selects, aligns, 
+//      extends or cuts power exactly as the knob and switch would, and 
+//      reports the mode, sensors, stats and config record.  See 
+//      serviceSerial() and tools/yardCtl.py.
+//      Power stage (optional, POWER_STAGE): track power through a MOSFET 
+//      that ramps up over POWER_RAMP_MS, with the current sampled while it 
+//      is on.  A short cuts the gate in under 1 ms and ends the window; 
+//      the OLED shows the trip until the next click tries again.
+//      Power districts (optional, POWER_DISTRICTS): each track has its own 
+//      feed from a 595 stage behind the turnout bits and only the aligned 
+//      track is live.  The knob stays live in TRACK_ACTIVE: a click on 
+//      another track ends the window and starts that move once the 
+//      window's inbound train has had "ladderClearSec" after its PassBy
+//      to get off the ladder; until then it waits for the window's end.
 
 //    *Setup Mode:  Plug in the 3 button select board to the I/O  18, 19, 23, and
 //     the administrator can select the staging yard and delay time to be used
-//     by the board.  Once selections have been made the system needs to be
-//     rebooted to enable the new choices to be written, during setup, from the 
-//     EEPROM.
+//     by the board.  "Accept & Exit" applies the new choices back in 
+//     STAND_BY once both sensors are clear, no reboot, like "C" on the
+//     serial line: track power drops, the new yard's map, encoder limits and 
+//     timers take over and its default track is aligned.  The choices are 
+//     also stored in the yardConfig record in NVS for the next boot.
+//     The menu is ticked from loop() like the other modes, so sensors keep
+//     reading, and a long press during TRACK_ACTIVE leaves the power window
+//     running until its timer ends.  The knob or the 3 buttons move the bar.
 
 //----------------------------Track Sensors Descriptions--------------------
 // All four staging yards have a single yard lead, from which all 
@@ -75,10 +117,63 @@
 #include <SPI.h>
 #include <Wire.h>
 #include "bcsjTimer.h"
-#include <OneButton.h>
+#include "buttonQueue.h"
 #include <EEPROM.h>
+#include "yardConfig.h"
+#include "sensorPair.h"
+#include "telemetry.h"                //---LOG_ macros, LOG_LEVEL picks what is built in
 #include <U8g2lib.h>
 
+//---Event-driven idle in STAND_BY, light sleep where the core has it; 0 to spin
+#define IDLE_LIGHT_SLEEP 1
+#if IDLE_LIGHT_SLEEP && defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <driver/uart.h>
+#endif
+
+//---Sensor storm benchmark, 1 to build it in: a "B" line on the serial port 
+//   in STAND_BY plays every case through readAllSens() and prints the numbers
+#ifndef SENSOR_BENCH
+#define SENSOR_BENCH 0
+#endif
+#if SENSOR_BENCH
+#include "sensorStorm.h"
+#define BENCH_HOST_PASS 100       //---us per sensor pass on the virtual clock
+#endif
+
+//---Input trace, 1 to build it in: every input edge and output change is
+//   kept in RAM from boot, a "T" line in STAND_BY dumps it for replay on 
+//   the host (tools/traceGrab.py, test/test_trace)
+#ifndef TRACE_CAPTURE
+#define TRACE_CAPTURE 0
+#endif
+#if TRACE_CAPTURE
+#include "inputTrace.h"
+#endif
+
+//---Track power through a MOSFET, 1 to build it in: soft start and an ADC 
+//   overcurrent trip (lib/trackPower) in place of the relay, the trip 
+//   reason on the OLED
+#ifndef POWER_STAGE
+#define POWER_STAGE 0
+#endif
+#if POWER_STAGE
+#include "trackPower.h"
+#endif
+
+//---Per-track power districts, 1 to build them in: a 595 stage chained 
+//   behind the turnout registers feeds each track, only the aligned one 
+//   is live, and a new move can start while the last window still runs
+#ifndef POWER_DISTRICTS
+#define POWER_DISTRICTS 0
+#endif
+#define DISTRICT_BYTES 3          //---24 outputs, output n feeds track n
+
 #define swVer "v2.7 - (2/19/2025)"
 
 //---Constructor for OLED screen
@@ -98,16 +193,35 @@ U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, /* reset=*/ U8X8_PIN_NONE);
 *            &WestStging,  #7                                        *
 *********************************************************************/
 
-//---------Variables written to EEPROM by "MENU" Function ------------
+//---------Variables written to NVS by "MENU" Function ---------------
 byte crntMapChoice = 3;           
 byte trackActiveDelayChoice = 1;
 
-//--------Variables set in void.setup() upon reading EEPROM----------
+//--------Variables set in void.setup() from the yardConfig record----
 byte crntMap = 4;
 byte trackActiveDelay = 1;
-
-//-----------------------setup read/write to ESP32 flash (EEPROM)----
-#define EEPROM_SIZE 8
+yardConfig config;                //---every tunable, one CRC checked NVS blob
+void useConfig();
+void reconfigure();
+
+//---Deferred flash writes: changes are flagged here and written together in
+//   one NVS commit once no sensor is busy and track power is off
+#define FLASH_CONFIG     0x01
+#define FLASH_OCCUPANCY  0x02
+byte       flashPending   = 0;
+bcsjTime64 flashStallLast = 0;    //--microseconds the last commit held the cores
+bcsjTime64 flashStallMax  = 0;
+bcsjTimer  timerFlashRetry;        //--a failed commit waits this out before the next
+bcsjTime64 interval_FlashRetry = bcsjSeconds(30);
+void flashDefer(byte what);
+void serviceFlash();
+
+//-----------------------old ESP32 flash (EEPROM) layout, read only----
+//   Only read when there is no valid yardConfig, to migrate a board
+//   running the earlier firmware.
+#define EEPROM_SIZE 64
+
+#define OCC_NVS_KEY    "occ"      //---yardOccupancy[8] in NVS, next to the yardConfig
 
 //------------Setup sensor debounce from Bounce2 library-----
 const byte mainSensInpin {26};
@@ -123,6 +237,7 @@ const byte ON        {0};
 const byte OFF       {1};
 
 const byte trackPowerLED_PIN  {2};  
+const byte powerSensePin      {34};    //---current sense amplifier, POWER_STAGE
 
 const byte MAX_LADDER_TRACKS {17};
 const byte MAX_TURNOUTS      {17};
@@ -330,6 +445,11 @@ const turnoutMap *mapData[8] = {
 };
 
 
+//---Route diff table, built once at boot for crntMap: number of turnouts
+//   that move going from route [from] to route [to]
+byte routeDiff[MAX_LADDER_TRACKS][MAX_LADDER_TRACKS];
+void buildRouteDiff();
+
 //-----Setup pins for 74HC595 shift register 
 const int latchPin = 33;   
 const int clockPin = 32;   
@@ -337,24 +457,65 @@ const int dataPin  = 25;
 
 //-----declare latch function----
 void writeTrackBits( uint16_t track);
+void shiftRegisters();
+void writeDistricts(uint32_t bits);
+uint16_t routeLatched  = 0;      //--turnout word on the 595s
+uint32_t districtBits  = 0;      //--district outputs behind them, POWER_DISTRICTS
+bcsjTime64 ladderClear   = bcsjSeconds(15); //--inbound PassBy until the train is in
+bcsjTime64 ladderClearAt = 0;    //--its track, 0 until this window's train is seen
 
 //---Instantiate a bcsjTimer.h object for screen sleep
 bcsjTimer  timerOLED;
 bcsjTimer  timerTortoise;
 bcsjTimer  timerTrainIO;
 bcsjTimer  timerTrackSelect;
+bcsjTimer  timerPreAlign;
+bcsjTimer  timerSplash;
 
 //---Timer Variables---
-unsigned long additionalScreenTime  = 1000000L * 60 * 1;    //+ screen timeout for sleep
-unsigned long interval_Tortoise     = 1000000L * 3;         //Tortoise run time interval
-unsigned long interval_OLED         = trackActiveDelay + additionalScreenTime;
-unsigned long interval_TrackSelect  = 1000000L * 5;         //---Display "new track selection for 5 //
+bcsjTime64 additionalScreenTime  = bcsjMinutes(1);          //+ screen timeout for sleep
+bcsjTime64 interval_Tortoise     = bcsjSeconds(3);          //Tortoise run time interval
+bcsjTime64 interval_OLED         = trackActiveDelay + additionalScreenTime;
+bcsjTime64 interval_TrackSelect  = bcsjSeconds(5);          //---Display "new track selection for 5 //
                                                             //seconds before return to Active Track //
+bcsjTime64 interval_PreAlign     = bcsjSeconds(2);          //knob dwell before speculative align
+bcsjTime64 interval_Splash       = bcsjSeconds(5);          //start up screen, non-blocking
+bcsjTime64 bootFirstSample       = 0;                       //us from reset to first sensor read
+
+//---Speculative route pre-alignment, opt-in
+bool     preAlignEnabled = false;
+uint16_t tracknumAligned = 0;      //--track whose route is latched in the 595s
+void alignTrack(uint16_t trackNum);
+void preAlignChoice();
+
+//---Yard occupancy, one bit per track for each of the 8 yards
+uint32_t yardOccupancy[8];
+bool     skipOccupied = false;     //--knob steps over occupied tracks for inbound trains
+bool isStagingTrack(uint16_t trackNum);
+bool isOccupied(uint16_t trackNum);
+void trackOccupancyEvent(byte direction);
+void saveOccupancy();
+
+//---Auto-route inbound trains to an empty track, opt-in
+autoPolicy autoRoutePolicy = AUTO_NEAREST;   //--values in yardConfig.h
+bool     autoRouteEnabled = false;
+bool     autoRouted       = false;  //--current move was started by auto-route
+bool     knobTouched      = false;  //--operator turned the knob since HOUSEKEEP
+uint16_t autoRouteLast    = 0;      //--last pick, for AUTO_ROUNDROBIN
+int  pickEmptyTrack();
+
+//---Automatic reverse loop exit on revSens INBOUND
+bool autoRevLoopEnabled = false;
 
 
 // Instantiate a Bounce object
+#if SENSOR_BENCH                  //---these read the storm script while it plays
+stormBounce debouncer1(0); stormBounce debouncer2(1); 
+stormBounce debouncer3(2); stormBounce debouncer4(3);
+#else
 Bounce debouncer1 = Bounce(); Bounce debouncer2 = Bounce(); 
 Bounce debouncer3 = Bounce(); Bounce debouncer4 = Bounce();
+#endif
 
 //---------------------OLED Display Functions------------------//
 byte oledState = true;
@@ -364,6 +525,9 @@ void tracknumChoiceText();
 void tracknumActiveText();
 void tracknumActiveTextSm();
 void tracknumActChoText();  //DISPLAY______may not need----review----
+void routeDiffText();
+unsigned long alignSeconds();
+void occupancyText();
 
 //---RotaryEncoder DEFINEs for numbers of tracks to access with encoder
 #define ROTARYSTEPS 1
@@ -371,10 +535,13 @@ void tracknumActChoText();  //DISPLAY______may not need----review----
 #define ROTARYMAX  mapData[crntMap]->numTracks
 
 //--- Setup a RotaryEncoder for GPIO pins 16, 17:
-RotaryEncoder encoder(17, 16);           //--digital pins to read encoder
+const byte encoderPinA  {17};
+const byte encoderPinB  {16};
+const byte encoderSwPin {4};
+RotaryEncoder encoder(encoderPinA, encoderPinB);  //--digital pins to read encoder
 uint8_t       lastPos = -1;              //-- Last known rotary position.
-OneButton     encoderSw1(4, true);       //---Setup  OneButton for rotary 
-                                         //   encoder sw on pin 13 - active low
+buttonQueue   encoderSw;                 //---gesture decoder for the rotary 
+                                         //   encoder sw on pin 4 - active low
 
 //---RotaryEncoder Setup and variables are in this section---------
 uint16_t tracknumChoice  = ROTARYMAX;
@@ -385,33 +552,64 @@ uint16_t tracknumActive  = ROTARYMAX;
 byte knobPosition = ROTARYMAX;
 bool knobToggle   = true;       //active low 
 void readEncoder();             //--RotaryEncoder Function------------------
-
-//--OneButton Function delarations for RotaryEncoder switch
+int  readEncoderSteps();
+void moveChoice(int newPos);
+
+//---Encoder acceleration: a detent arriving sooner than these after the last
+//   one moves the choice 3 or 2 tracks.  The screen redraws at most once per
+//   interval_Frame however fast the knob spins.
+long       encoderLastRaw    = 0;
+bcsjTime64 encoderLastDetent = 0;
+bcsjTime64 encoderFastGap    = bcsjMillis(25);
+bcsjTime64 encoderMedGap     = bcsjMillis(60);
+bcsjTime64 interval_Frame    = bcsjMillis(40);
+bcsjTimer  timerFrame;
+bool       choiceDirty       = false;   //--choice moved, screen not redrawn yet
+unsigned long diffShownSecs  = 0;       //--alignment time routeDiffText last drew
+
+//--Gesture Function delarations for RotaryEncoder switch
 
 void click1();
 void doubleclick1();
 void longPressStart1();
+void serviceButton();
+void encoderSwISR();
 
 bool bailOut = true;  //active low, set active by doubleclick to end timer 
 
 //---------------SETUP STATE Machine and State Functions----------------------
-enum {HOUSEKEEP, STAND_BY, TRACK_SETUP, TRACK_ACTIVE, OCCUPIED, MENU} mode;
+enum {HOUSEKEEP, STAND_BY, TRACK_SETUP, TRACK_ACTIVE, OCCUPIED, MENU, REV_LOOP, BOOT} mode;
+const char *const modeNames[] = {"HOUSEKEEP", "STAND_BY", "TRACK_SETUP", "TRACK_ACTIVE",
+                                 "OCCUPIED", "MENU", "REV_LOOP", "BOOT"};
 void runHOUSEKEEP();
 void runSTAND_BY();
 void runTRACK_SETUP();
 void runTRACK_ACTIVE();
 void runOCCUPIED();
 void runMENU();
+void runREV_LOOP();
+void runBOOT();
 //void selectYARD();
 //void selectTIME();
 void leaveTrack_Setup();
 void leaveTrack_Active();
+bool nextMove();
 
 //---runMenu Functions Declarations--------------
 void runMAINMENU();
 void runYARDMENU();
 void runDELAYMENU();
-void runACTIONMENU();
+void openMenu();
+void closeMenu();
+void drawMenu();
+int  menuCount();
+
+//---runMenu Variables
+enum {MENU_MAIN, MENU_YARD, MENU_DELAY} menuScreen = MENU_MAIN;
+byte menuCursor  = 0;
+bool menuSelect  = false;       //--click or SELECT button, picked up by runMENU
+bool menuDirty   = true;
+bool menuRequest = false;       //--long press seen, menu opens at the next safe point
 
 //---Sensor Function Declarations---------------
 void readMainSens();
@@ -420,21 +618,62 @@ void rptMainDirection();
 void rptRevDirection();
 void readAllSens();
 
+//---Serial line commands, sensor storm benchmark and input trace
+#define SERIAL_LINE  64           //---longest command line, "C" with a record
+char serialLine[SERIAL_LINE];
+byte serialLen      = 0;
+bool serialOverrun  = false;      //--line too long, refused at its end
+bool configRequest  = false;      //--"C" or Accept & Exit, applied in STAND_BY
+yardConfig configIncoming;
+void serviceSerial();
+void serialCommand(char *line);
+void serialReply(const char *text);
+bool yardIdle();
+void traceRemote(char command, byte arg);
+void benchRun(uint8_t id);
+bool benchPassBy = false;         //--last case gave a PassBy
+void traceStart();
+void tracePoll();
+void traceWrite(uint8_t c);
+
 //---State Machine Variables
 byte railPower = OFF;
-
-//---Sensor variables
-byte mainSensTotal      = 0,      mainSens_Report    = 0; 
-byte mainPassByState    = false,  mainPassByTotal    = 0;
-byte mainInValue        = 1,      mainIn_LastValue   = 1; 
-byte mainOutValue       = 1,      mainOut_LastValue  = 1;
-byte main_LastDirection = 0,      mainDirection      = 0;
-
-byte revSensTotal       = 0,      revSens_Report     = 0; 
-byte revPassByState     = false,  revPassByTotal     = 0;
-byte revInValue         = 1,      revIn_LastValue    = 1; 
-byte revOutValue        = 1,      revOut_LastValue   = 1;
-byte revDirection       = 0,      rev_LastDirection  = 0;
+byte powerLevel = LOW;            //--what powerOut() last drove, HIGH is power on
+byte tripShown  = 0;              //--TRIP_ reason servicePower() has acted on
+void powerOut(byte level);
+void writeRailPower();
+void servicePower();
+const char *powerText();
+byte modeLogged = 0xFF;           //--last state sent as LOG_MODE
+void logState(byte state);
+
+//---Idle Function Declarations---------------
+void idleSetup();
+void idleWait();
+void idleNotifyFromISR();
+void idleNotifyFromTask();
+void idleResponded();
+
+//---Idle variables: wake-to-response latency in microseconds
+bcsjTime64 idleHoldoff       = bcsjSeconds(1);  //--stay awake this long after an edge
+bcsjTime64 idleMaxBlock      = bcsjSeconds(1);  //--longest single block
+bcsjTime64 idleLatencyLast   = 0;
+bcsjTime64 idleLatencyMax    = 0;
+uint32_t   idleWakeCount     = 0;
+volatile bcsjTime64 idleEdgeStamp = 0;          //--first edge since the block began
+volatile bcsjTime64 idleLastEdge  = 0;
+bool       idleBlocked       = false;
+
+//---Sensor variables, decoded by lib/sensorPair; the names below are the
+//   fields of each pair
+sensorPair mainPair, revPair;
+byte &mainSensTotal      = mainPair.total,          &mainSens_Report    = mainPair.report; 
+byte &mainPassByState    = mainPair.passByState;
+byte &main_LastDirection = mainPair.lastDirection,  &mainDirection      = mainPair.direction;
+
+byte &revSensTotal       = revPair.total,           &revSens_Report     = revPair.report; 
+byte &revPassByState     = revPair.passByState;
+byte &rev_LastDirection  = revPair.lastDirection,   &revDirection       = revPair.direction;
 
 
 
@@ -444,20 +683,36 @@ byte revDirection       = 0,      rev_LastDirection  = 0;
 
 void setup() 
 {
-  Serial.begin(115200);
-  delay(1000);  //time to bring up serial monitor
-  Wire.setClock(1000000L);
-  u8g2.begin(/*Select=*/ 19, /*Right/Next=*/ 18, /*Left/Prev=*/ 23);
-
-  /*---- Setup EEPROM and variables for Menu function------------------*
+  Serial.begin(115200);           //---no wait for a monitor, boot goes straight 
+                                  //   on to sampling the sensors
+  LOG_BEGIN(Serial);              //---binary telemetry, tools/yardTelemetry.py
+  mode = BOOT;                    //---runBOOT takes over once the splash is up
+  powerLevel = LOW;               //---relay and gate are off out of reset
+  tripShown  = 0;
+
+  /*---- Setup config record and variables for Menu function----------*
   *      crntMap and trackActiveDelay variables dictate which staging  *
   *      map and time delay are used by this board.                    *  
   *      The "choice" variables are set to current values for use with *
   *      the runMenu to setup a different combinations when needed.    *
+  *      A missing or damaged record falls back to defaults plus the   *
+  *      bytes the earlier firmware kept in EEPROM.                    *
   *********************************************************************/
-  EEPROM.begin(EEPROM_SIZE);
-  crntMap          = EEPROM.read(0);         //read staging yard map from EEPROM
-  trackActiveDelay = EEPROM.read(1);         //read trk pwr delay time from EEPROM
+  memset(yardOccupancy, 0, sizeof(yardOccupancy));
+  if(configLoad(config) == true)            //---single NVS read
+  {
+    nvsReadBlob(OCC_NVS_KEY, yardOccupancy, sizeof(yardOccupancy));
+  }
+  else 
+  {
+    configDefaults(config);
+    EEPROM.begin(EEPROM_SIZE);
+    configMigrate(config, EEPROM.read(0), EEPROM.read(1));
+    EEPROM.end();
+    flashDefer(FLASH_CONFIG);
+    saveOccupancy();
+  }
+  useConfig();
   crntMapChoice          = crntMap;          
   trackActiveDelayChoice = trackActiveDelay; 
       
@@ -468,34 +723,53 @@ void setup()
   //---setup the Bounce pins and intervals :
   debouncer1.attach(mainSensInpin); debouncer2.attach(mainSensOutpin);
   debouncer3.attach(revSensInpin);  debouncer4.attach(revSensOutpin);
-  debouncer1.interval(5);           debouncer2.interval(5); // interval in ms
-  debouncer3.interval(5);           debouncer4.interval(5); 
-
-  //---set pin for driving track power relay 
+  debouncer1.interval(config.debounceMs); debouncer2.interval(config.debounceMs); // in ms
+  debouncer3.interval(config.debounceMs); debouncer4.interval(config.debounceMs); 
+  sensorPairInit(mainPair); sensorPairInit(revPair);
+  traceStart();                             //---capture from the first sample on
+  readAllSens();
+  bootFirstSample = bcsjNow();              //---time from reset to first sample
+
+  //---set pin for driving track power relay, or the MOSFET gate and its
+  //   current sense
+#if POWER_STAGE
+  powerStage.begin(trackPowerLED_PIN, powerSensePin);
+  powerStage.onTrip = idleNotifyFromTask;
+#else
   pinMode(trackPowerLED_PIN, OUTPUT); 
+#endif
 
-  //---set up click routines for the encoder switch
-  encoder.setPosition(ROTARYMAX / ROTARYSTEPS); // start with ROTARYMAX value
-  encoderSw1.attachClick(click1);
-  encoderSw1.attachDoubleClick(doubleclick1);
-  encoderSw1.attachLongPressStart(longPressStart1);
-  encoderSw1.setPressMs(6000);              //---set longPress delay to 6 seconds,
-                                               //    Used to call menu function by
-                                               //    holding the encoder switch down
-
-  //---Shift register pins
+  //---Shift register pins, then start the default route moving so the 
+  //   Tortoises travel while the OLED comes up
   pinMode(latchPin, OUTPUT);
   pinMode(dataPin,  OUTPUT);  
   pinMode(clockPin, OUTPUT); 
-  
-
-  //---setup variables for start sequence
-  writeTrackBits(mapData[crntMap]->routes[mapData[crntMap]->defaultTrack]);
-  digitalWrite(trackPowerLED_PIN, HIGH);
+  buildRouteDiff();
+  alignTrack(mapData[crntMap]->defaultTrack);
+  powerOut(HIGH);
               
   tracknumChoice = (mapData[crntMap]->defaultTrack);
   tracknumActive = (mapData[crntMap]->defaultTrack);
   lastPos        = (mapData[crntMap]->defaultTrack);
+  knobToggle     = true;                   //---no click, double click or long
+  bailOut        = true;                   //   press carried over from before
+  menuRequest    = false;                  //   a restart
+
+  idleSetup();                             //---input interrupts and light sleep
+
+  //---set up click routines for the encoder switch
+  encoder = RotaryEncoder(encoderPinA, encoderPinB);   // rest state of A/B now
+  encoderLastRaw = encoder.getPosition();       // readEncoder works from deltas
+  pinMode(encoderSwPin, INPUT_PULLUP);
+  encoderSw.setTimes(bcsjMillis(50),           //---debounce
+                     bcsjMillis(400),          //---second click window
+                     bcsjSeconds(6));          //---set longPress delay to 6 seconds,
+                                               //    Used to call menu function by
+                                               //    holding the encoder switch down
+  attachInterrupt(digitalPinToInterrupt(encoderSwPin), encoderSwISR, CHANGE);
+
+  Wire.setClock(1000000L);
+  u8g2.begin(/*Select=*/ 19, /*Right/Next=*/ 18, /*Left/Prev=*/ 23);
   
   //---display settings for this board during boot sequence
   u8g2.clearBuffer();
@@ -513,8 +787,9 @@ void setup()
     u8g2.drawHLine(0, 45, 128); 
    u8g2.sendBuffer();
 
-  delay(5000);
-  digitalWrite(trackPowerLED_PIN, LOW);
+  LOG_TIMING(LOG_T_BOOT_SAMPLE, bootFirstSample);
+  timerSplash.start(interval_Splash);      //---runBOOT keeps the sensors live 
+                                           //   while the splash is up
   
 } //-----------------------End setup-----------------------------
 
@@ -523,15 +798,13 @@ void setup()
 //--------------------------------------------------------------//
 
 void loop() 
-{                         /*DEBUG__________________________
-                          Serial.println("---------------------void Loop-----");
-                          Serial.print("trackNumChoice(void loop ent):    ");
-                          Serial.println(tracknumChoice);
-                          Serial.print("tracknumActive(void loop ent):    ");
-                          Serial.println(tracknumActive); */
-  
-  if(railPower == ON)  digitalWrite(trackPowerLED_PIN, HIGH);
-  else                 digitalWrite(trackPowerLED_PIN, LOW);
+{
+  bcsjTimers.poll();           //---fire expired timers once per pass
+  serviceFlash();              //---deferred NVS writes, if it is safe now
+  LOG_PUMP();                  //---telemetry the UART has room for
+
+  if(mode == BOOT) {}          //---start up lamp, runBOOT owns the pin
+  else writeRailPower();
 
   if (mode == HOUSEKEEP)         {runHOUSEKEEP();}
   else if (mode ==     STAND_BY) {runSTAND_BY();}
@@ -539,26 +812,8 @@ void loop()
   else if (mode == TRACK_ACTIVE) {runTRACK_ACTIVE();}
   else if (mode ==     OCCUPIED) {runOCCUPIED();}
   else if (mode ==         MENU) {runMENU();}
-  
-  /*----debug terminal print----------------*/
-                          //Serial.print("mainSensTotal:      ");
-                          //Serial.print(mainSensTotal);
-                          //Serial.print("           revSensTotal:  ");
-                          //Serial.println(revSensTotal);
-                          //Serial.print("mainPassByState:    ");
-                          //Serial.print(mainPassByState);
-                          //Serial.print("          revPassByState: ");
-                          //Serial.println(revPassByState); 
-                          //Serial.print("main_LastDirection: ");
-                          //Serial.print(main_LastDirection);
-                          //Serial.print("       rev_lastDirection: ");
-                          //Serial.println(rev_LastDirection);
-                          //Serial.print("tracknumActive(vloop exit):    ");
-                          //Serial.println(tracknumActive);
-                          //Serial.print("Mode(vloop exit):  ");
-                          //Serial.println(mode);
-
- //---end debug printing-------------
+  else if (mode ==     REV_LOOP) {runREV_LOOP();}
+  else if (mode ==         BOOT) {runBOOT();}
 }     
  //------------------------END main loop-------------------
  
@@ -572,27 +827,34 @@ void loop()
  *                                                                * 
  *----------------------------------------------------------------*/
 
+//--------------------State Change Log----------------------------
+void logState(byte state)   //--from the top of every state function, a change
+{                           //  since the last call goes out as LOG_MODE
+  if(state == modeLogged) return;
+  LOG_MODE(modeLogged, state);
+  modeLogged = state;
+}
+
 //--------------------HOUSEKEEP Function--------------------------
 void runHOUSEKEEP()
 {
+  logState(HOUSEKEEP);
   oledOn();
-                                  /*---DEBUG
-                                  Serial.println();
-                                  Serial.println("--------------------HOUSEKEEP---"); */
   
   if((tracknumActive < ROTARYMAX) || (mapData[crntMap]->revL == false)) railPower = OFF;
-  if(railPower == ON)  digitalWrite(trackPowerLED_PIN, HIGH);
-  else  digitalWrite(trackPowerLED_PIN, LOW);
+  writeRailPower();
     
   u8g2.clearBuffer();
   tracknumChoiceText();
+  occupancyText();
   
       u8g2.setFont(u8g2_font_helvB10_te);     
       u8g2.drawStr(3,18, "Rotate"); 
       //u8g2.setFont(u8g2_font_helvR08_te);   commented out 1/10/2025
       u8g2.drawStr(3,35, "to select");
       u8g2.setFont(u8g2_font_helvB10_te);
-      /*if (railPower == ON) {*/u8g2.drawStr(3,61,"Push to activate"); /*/}
+      if (tripShown) {u8g2.drawStr(3,61,powerText()); }   //--until the next try
+      else {u8g2.drawStr(3,61,"Push to activate"); }
       //else {u8g2.drawStr(3,64,"TRK POWER OFF"); } */ //added 1/10/2025
   u8g2.drawHLine(0, 45, 128);
   u8g2.sendBuffer(); 
@@ -600,16 +862,15 @@ void runHOUSEKEEP()
   timerOLED.start(interval_OLED);   /*--start sleep timer here for when HOUSEKEEP 
                                       state is entered after moving through states
                                       and no knob twist.                         */
+  knobTouched = false;
+  autoRouted  = false;
   mode = STAND_BY;
 }  
 
 //-----------------------STAND_BY Function-----------------
 void runSTAND_BY()
 {
-                    /*---DEBUG  
-                    Serial.println("-----------------------STAND_BY---");
-                    Serial.print("------standBy Last Position:  ");
-                    Serial.println(lastPos);  */
+  logState(STAND_BY);
 
 //---Begin main do-while loop checking for user input--------
   do
@@ -620,21 +881,58 @@ void runSTAND_BY()
 
     readEncoder();
     readAllSens();
-    encoderSw1.tick();  //check for clicks
+    serviceButton();    //check for clicks and serial commands
+    serviceFlash();     //deferred NVS writes
+    LOG_PUMP();         //telemetry
+    if(menuRequest == true)
+    {
+      openMenu();
+      return;
+    }
+    if((configRequest == true) && yardIdle())  //---"C" on the serial line or the
+    {                                          //   menu's Accept & Exit, once the
+                                               //   lead is clear
+      configRequest = false;
+      config = configIncoming;
+      reconfigure();
+      mode = HOUSEKEEP;
+      return;
+    }
+    if(preAlignEnabled) preAlignChoice();
+    if(autoRouteEnabled && (mainDirection == INBOUND) && (knobTouched == false))
+    {
+      int pick = pickEmptyTrack();
+      if(pick >= 0)                    //---act as if the operator chose and clicked
+      {
+        tracknumChoice = pick;
+        lastPos        = pick;
+        autoRouteLast  = pick;
+        autoRouted     = true;
+        break;
+      }
+    }
+    if(autoRevLoopEnabled && (mapData[crntMap]->revL == true) &&
+       (revDirection == INBOUND) && (mainSens_Report == 0))
+    {
+      mode = REV_LOOP;                 //---loop train heading out, throat is clear
+      return;
+    }
     if((mainSens_Report > 0) || (revSens_Report > 0))
     {
-                                
-                    //--DEBUG: Serial.println("---to OCCUPIED from STAND_BY---");
       oledOn();    
       u8g2.sendBuffer();                
       runOCCUPIED();
     }
+    idleResponded();
+    if(knobToggle == true) idleWait(); //---block until an input edge or timer
   }
   while (knobToggle == true);        //---check rotary switch pressed to select a 
                                      //   track (active low)
   
   tracknumActive = tracknumChoice;  
   knobToggle = true;                 //--reset so readEncoder will run in stand_by
+  bailOut = true;                    //--reset (active low), a doubleclick from here
+                                     //  on cuts this move's power window
   timerOLED.disable();
 
   u8g2.sendBuffer();
@@ -647,12 +945,14 @@ void runSTAND_BY()
 //-----------------------TRACK_SETUP- State Function-----------------------
 void runTRACK_SETUP()
 {
+  logState(TRACK_SETUP);
   readAllSens();
   railPower = OFF;
-  if(railPower == ON)  digitalWrite(trackPowerLED_PIN, HIGH);
-  else  digitalWrite(trackPowerLED_PIN, LOW);
-                            //--DEBUG: Serial.println("------------------------TRACK_SETUP---");
-  writeTrackBits(mapData[crntMap]->routes[tracknumActive]);
+  writeRailPower();
+  if(tracknumAligned != tracknumActive)   //--already pre-aligned: timerTortoise
+  {                                       //  holds only the leftover travel
+    alignTrack(tracknumActive);
+  }
 
   u8g2.clearBuffer();
   tracknumChoiceText();
@@ -663,31 +963,26 @@ void runTRACK_SETUP()
     u8g2.drawHLine(0, 45, 128);
   u8g2.sendBuffer();
   
-  timerTortoise.start(interval_Tortoise);   //--begin delay for Tortoises
-  while(timerTortoise.running() == true)
+  while(timerTortoise.running() == true)   //--delay for Tortoises
   {
    readAllSens();
+   serviceButton();
   }
   railPower = ON;
-  if(railPower == ON)  digitalWrite(trackPowerLED_PIN, HIGH);
-  else  digitalWrite(trackPowerLED_PIN, LOW);
-  bailOut = true;                          //--reset (active low)
+  writeRailPower();
   leaveTrack_Setup();
   
 }  //---end track setup function-------------------
 
 void leaveTrack_Setup()
 {
-                          //--DEBUG: Serial.println("---Entering leaveTrack_Setup---");
   readAllSens();
-  if((mainSens_Report > 0) || (revSens_Report > 0))
-  {
-                          //--DEBUG: Serial.println("---to OCCUPIED from leaveTrack_Setup---");
+  if(((mainSens_Report > 0) || (revSens_Report > 0)) && (autoRouted == false))
+  {                       //--an auto-routed train is expected on the sensor
     mode = OCCUPIED;
   }
   else 
   {
-                          //--DEBUG: Serial.println("--times up--leaving TrackSetup--");
     mode = TRACK_ACTIVE;
   }
 }
@@ -696,8 +991,9 @@ void leaveTrack_Setup()
 void runTRACK_ACTIVE()
 {
     //---begin timere to keep track power on for "n" minutes
-  unsigned long interval_TrainIO  = 1000000L * 60 * trackActiveDelay;  
+  bcsjTime64 interval_TrainIO  = bcsjMinutes(trackActiveDelay);  
   
+  logState(TRACK_ACTIVE);
   readAllSens();
     
   u8g2.clearBuffer();
@@ -706,24 +1002,34 @@ void runTRACK_ACTIVE()
     u8g2.drawStr(3,18, "Start");
     u8g2.drawStr(3,35, "now!"); 
     u8g2.setFont(u8g2_font_helvB10_te); 
-    if (railPower == ON) {u8g2.drawStr(3,61,"Track power ON"); }
-    else {u8g2.drawStr(3,61,"Track power OFF"); }
+    u8g2.drawStr(3,61,powerText());
     u8g2.drawHLine(0, 45, 128);  
   u8g2.sendBuffer();
   
-                    //--DEBUG: Serial.println("-----------------------TRACK_ACTIVE---");
-  rev_LastDirection = 0; //reset for use during the next TRACK_ACTIVE call
-  main_LastDirection = 0;
+  if(revSens_Report == 0)  rev_LastDirection = 0; //reset for use during the next 
+  if(mainSens_Report == 0) main_LastDirection = 0; //TRACK_ACTIVE call, unless a
+                                                   //train is on the sensor now
   timerTrainIO.start(interval_TrainIO);
+  ladderClearAt = 0;
   do
   {
      readAllSens();
-     encoderSw1.tick();
+     serviceButton();
      
     if (bailOut == 0)       //active low: active if doubleclick encoder knob
     {
       break;
     }
+    if (menuRequest == true)  //long press: menu takes over, power window still
+    {                         //runs and runMENU cuts power when it ends
+      break;
+    }
+#if POWER_DISTRICTS
+    if (nextMove() == true)   //click on another track: this window ends now,
+    {                         //the next move starts from STAND_BY at once
+      break;
+    }
+#endif
         //--true when outbound train completely leaves sensor  
     if (((mainPassByState == 1) && (main_LastDirection == 2)) ||
        ((rev_LastDirection == 2) && (revPassByState == 1)))           
@@ -738,19 +1044,54 @@ void runTRACK_ACTIVE()
   leaveTrack_Active();
 }  //--end runTrack_Active---
 
+bool nextMove()          //--POWER_DISTRICTS: the knob stays live in TRACK_ACTIVE.
+{                       //  Only this track's district is fed, so once this 
+                        //  window's train is in its track the next one can go.
+                        //  Clear sensors alone say nothing, a train on the 
+                        //  ladder is between them: an inbound PassBy and 
+                        //  ladderClear after it.  An outbound PassBy ends the
+                        //  window anyway, any other click waits it out
+  if((ladderClearAt == 0) &&
+     (((mainPassByState == 1) && (main_LastDirection == INBOUND)) ||
+      ((revPassByState  == 1) && (rev_LastDirection  == INBOUND))))
+  {
+    ladderClearAt = bcsjNow() + ladderClear;
+  }
+  int steps = readEncoderSteps();
+  moveChoice(lastPos + (steps * ROTARYSTEPS));
+  if (choiceDirty && timerFrame.done()) {
+    choiceDirty = false;
+    timerFrame.start(interval_Frame);
+    bool same = (tracknumChoice == tracknumActive);
+    u8g2.clearBuffer();
+      tracknumChoiceText();
+      u8g2.setFont(u8g2_font_helvB10_te);     
+      u8g2.drawStr(3,18, same ? "Start" : "Next:");
+      u8g2.drawStr(3,35, same ? "now!" : "push");
+      u8g2.drawStr(3,61,powerText());
+      u8g2.drawHLine(0, 45, 128);  
+    u8g2.sendBuffer();
+  }
+  return (knobToggle == false) && (tracknumChoice != tracknumActive) &&
+         (ladderClearAt != 0) && (bcsjNow() >= ladderClearAt) &&
+         (mainSens_Report == 0) && (revSens_Report == 0);
+}
+
 //---------------------leaveTrack_Active Function--------------------
 
 void leaveTrack_Active()
 {
   readAllSens();
-  if((mainSens_Report > 0) || (revSens_Report > 0))
+  if(menuRequest == true)
+  {
+    openMenu();
+  }
+  else if((mainSens_Report > 0) || (revSens_Report > 0))
   {
-                    //--DEBUG: Serial.println("--to OCCUPIED from leavTrack_Active-");
     mode = OCCUPIED;
   }
   else 
   {
-                    //--DEBUG: Serial.println("--times up leaving TrackActive--");
     mode = HOUSEKEEP;
   }
 }
@@ -758,12 +1099,12 @@ void leaveTrack_Active()
 //-------------------------OCCUPIED State Function--------------------
 void runOCCUPIED()
 {
-                   //--DEBUG: Serial.println("OCCUPIED");
+  logState(OCCUPIED);     //--STAND_BY calls it directly, mode stays STAND_BY
   
   while((mainSens_Report > 0) || (revSens_Report > 0))
   {
     readAllSens();
-                    //--DEBUG: Serial.println("----to OCCUPIED from OCCUPIED---");
+    serviceButton();
 
     u8g2.clearBuffer();
       u8g2.setFont(u8g2_font_helvB10_te);     
@@ -771,155 +1112,346 @@ void runOCCUPIED()
       u8g2.setFont(u8g2_font_helvR08_te); 
       u8g2.drawStr(3,35, "wait");
       u8g2.setFont(u8g2_font_helvB10_te); 
-      if (railPower == ON) {u8g2.drawStr(3,61,"Track power ON"); }
-      else {u8g2.drawStr(3,61,"Track power OFF"); }
+      u8g2.drawStr(3,61,powerText());
       u8g2.drawHLine(0, 45, 128); 
     u8g2.sendBuffer();
   }
-                    //--DEBUG: Serial.println("----Leaving OCCUPIED---");
   runHOUSEKEEP();
 }
 
+//-------------------------BOOT State Function------------------------
+void runBOOT()          //--splash screen up and default route aligning, with 
+{                       //  the sensors and switch already live
+  logState(BOOT);
+  readAllSens();
+  serviceButton();
+  bool busy = (mainSens_Report > 0) || (revSens_Report > 0);
+  if(timerSplash.running() && (busy == false)) return;
+  if(timerTortoise.running() && (busy == false)) return;
+
+  powerOut(LOW);
+  mode = HOUSEKEEP;     //--a busy sensor goes on to OCCUPIED from STAND_BY
+}
+
+//-------------------------REV_LOOP State Function--------------------
+void runREV_LOOP()
+{
+  logState(REV_LOOP);
+  uint16_t prevTrack = tracknumAligned;     //---restored once the train is out
+                                            //   through mainSens
+  byte     prevPower = railPower;
+  bailOut = true;                           //---doubleclick cuts loop power
+  revPassByState = false;                   //---the PassBy of this train, from here
+
+  railPower = OFF;
+  writeRailPower();
+  alignTrack(ROTARYMAX);                    //---reverse loop route is routes[numTracks]
+
+  oledOn();
+  u8g2.clearBuffer();
+    u8g2.setFont(u8g2_font_fub35_tf);
+    u8g2.drawStr(72,40,"RL");
+    u8g2.setFont(u8g2_font_helvB10_te);     
+    u8g2.drawStr(3,18, "Reverse"); 
+    u8g2.drawStr(3,35, "loop"); 
+    u8g2.drawStr(3,61, "Aligning route");
+    u8g2.drawHLine(0, 45, 128);
+  u8g2.sendBuffer();
+
+  while(timerTortoise.running() == true)
+  {
+    readAllSens();
+    serviceButton();
+  }
+  if(bailOut == true) railPower = ON;
+  writeRailPower();
+
+  u8g2.setDrawColor(0);
+  u8g2.drawBox(0, 47, 128, 17);
+  u8g2.setDrawColor(1);
+  u8g2.drawStr(3,61,powerText());
+  u8g2.sendBuffer();
+
+  while(revSens_Report > 0)                 //---PassBy or back out, either way
+  {                                         //   the sensor clears
+    readAllSens();
+    serviceButton();
+    if((bailOut == 0) && (railPower == ON))
+    {
+      railPower = OFF;                      //---doubleclick: cut power, wait it out
+      powerOut(LOW);
+    }
+  }
+  if(revPassByState == false)               //---backed out into the loop: points
+  {                                         //   stay on RL, nothing moved under it
+    if(bailOut == true) railPower = prevPower;
+    writeRailPower();
+    mode = HOUSEKEEP;
+    return;
+  }
+  revPassByState  = false;
+  mainPassByState = false;
+
+  timerTrainIO.start(bcsjMinutes(trackActiveDelay)); //---on the ladder, heading
+  bool cleared = false;                              //   for the throat
+  while((timerTrainIO.running() == true) || (mainSens_Report > 0))
+  {
+    readAllSens();
+    serviceButton();
+    if((mainPassByState == 1) && (main_LastDirection == OUTBOUND))
+    {
+      cleared = true;                       //---out through mainSens, ladder is clear
+      break;
+    }
+    if((bailOut == 0) && (railPower == ON))
+    {
+      railPower = OFF;
+      powerOut(LOW);
+    }
+  }
+  mainPassByState = false;
+
+  railPower = OFF;                          //---points never move under power
+  writeRailPower();
+  if(cleared == false)                      //---still on the ladder as far as we
+  {                                         //   know: power off, route left on RL
+    mode = HOUSEKEEP;
+    return;
+  }
+  if(prevTrack != tracknumAligned) alignTrack(prevTrack);
+  while(timerTortoise.running() == true)
+  {
+    readAllSens();
+    serviceButton();
+  }
+  if(bailOut == true) railPower = prevPower;
+  writeRailPower();
+  mode = HOUSEKEEP;
+}
+
 //------------------------ReadEncoder Function----------------------
 
+int readEncoderSteps()   //--detents since the last call, scaled by spin speed
+{
+  encoder.tick();
+  long raw   = encoder.getPosition();
+  long steps = raw - encoderLastRaw;
+  if (steps == 0) return 0;
+  encoderLastRaw = raw;
+
+  bcsjTime64 now = bcsjNow();
+  bcsjTime64 gap = now - encoderLastDetent;
+  encoderLastDetent = now;
+  if (gap < encoderFastGap)     steps *= 3;
+  else if (gap < encoderMedGap) steps *= 2;
+  return steps;
+}
+
 void readEncoder()
 { 
-  encoder.tick();
-  int newPos = encoder.getPosition() * ROTARYSTEPS;
-                    /*---DEBUG
-                    Serial.println("-------ENCODER");
-                    Serial.print("lastPos: ");
-                    Serial.println(lastPos);   
-                    Serial.print("newPos: ");
-                    Serial.println(newPos);  */
-                           
+  int steps  = readEncoderSteps();
+  moveChoice(lastPos + (steps * ROTARYSTEPS));
+  if (knobTouched && (alignSeconds() != diffShownSecs)) {
+    choiceDirty = true;                      //--a pre-align counting down
+  }
+  if (choiceDirty && timerFrame.done()) {    //--one redraw per frame, showing 
+    choiceDirty = false;                     //  wherever the knob has got to
+    timerFrame.start(interval_Frame);
+
+    u8g2.clearBuffer();
+      tracknumChoiceText();
+      occupancyText();
+      //tracknumActiveTextSm();  commented out 1/10/2024
+      u8g2.setFont(u8g2_font_helvB10_te);     
+      u8g2.drawStr(3,18, "Rotate"); 
+      //u8g2.setFont(u8g2_font_helvR08_te); commented out 1/10/2024
+      routeDiffText();                       //--replaces "to select" while browsing
+      u8g2.setFont(u8g2_font_helvB10_te); 
+      //u8g2.drawStr(3,64,"ACTIVE");
+      if (tripShown) {u8g2.drawStr(3,61,powerText()); }
+      else {u8g2.drawStr(3,61,"Push to activate"); }
+      u8g2.drawHLine(0, 45, 128);  
+    u8g2.sendBuffer();
+  }
+} 
+
+void moveChoice(int newPos)   //--the knob, or "S" on the serial line, asks for newPos
+{
   if (newPos < ROTARYMIN) {
-    encoder.setPosition(ROTARYMIN / ROTARYSTEPS);
     newPos = ROTARYMIN;
   } 
   else if (newPos > ROTARYMAX) {
-    encoder.setPosition(ROTARYMAX / ROTARYSTEPS);
     newPos = ROTARYMAX;
   } 
+  if (skipOccupied && (mainDirection == INBOUND) &&     //--only a train coming in needs an
+      (lastPos != newPos) && isOccupied(newPos)) {      //  empty track, one leaving is on one
+    int step = (newPos > lastPos) ? 1 : -1;    //---keep going the way the knob turned
+    while ((newPos >= ROTARYMIN) && (newPos <= ROTARYMAX) && isOccupied(newPos)) {
+      newPos += step;
+    }
+    if ((newPos < ROTARYMIN) || (newPos > ROTARYMAX)) newPos = lastPos;  //--all full
+  }
   if (lastPos != newPos) {
     lastPos = newPos;
     tracknumChoice = newPos;
+    knobTouched = true;                      //--manual choice overrides auto-route
     
     oledOn();
-                    /*---DEBUG
-                    Serial.println("-------ENCODER");
-                    Serial.print("newPos: ");
-                    Serial.println(newPos);   
-                    Serial.print("Choice: ");
-                    Serial.println(tracknumChoice);
-                    Serial.print("Active: ");
-                    Serial.println(tracknumActive);
-                    Serial.print("bailOut:   ");
-                    Serial.println(bailOut);  
-                    Serial.println("leave ENCODER"); */ 
                         
     timerOLED.start(interval_OLED);          //--sleep timer for STAND_BY mode
-
-    u8g2.clearBuffer();
-      tracknumChoiceText();
-      //tracknumActiveTextSm();  commented out 1/10/2024
-      u8g2.setFont(u8g2_font_helvB10_te);     
-      u8g2.drawStr(3,18, "Rotate"); 
-      //u8g2.setFont(u8g2_font_helvR08_te); commented out 1/10/2024
-      u8g2.drawStr(3,35, "to select");
-      u8g2.setFont(u8g2_font_helvB10_te); 
-      //u8g2.drawStr(3,64,"ACTIVE");
-      u8g2.drawStr(3,61,"Push to activate");
-      u8g2.drawHLine(0, 45, 128);  
-    u8g2.sendBuffer();
-    Serial.println("---------sendBuffer CHOICE");
+    timerPreAlign.start(interval_PreAlign);  //--restart knob dwell for pre-align
+    choiceDirty = true;
   }
-} 
+}
 
 /****************runMENU functions note******************************
 *   See the notes in the main code explanation above.               *
+*   The menu is a state like any other: runMENU() is called once    *
+*   per pass of loop(), reads the sensors, keeps the power window   *
+*   honest, and moves the cursor from the knob, the clicks and the  *
+*   3 button select board.  Nothing here blocks.                    *
 *********************************************************************/
 
+const char *const mainMenuItems[]  = {"Yard", "Time", "Accept & Exit", "EXIT"};
+const char *const yardMenuItems[]  = {"Wheeling", "Parkersburg", "Bayview", "Cumberland",
+                                      "Test", "Charleston", "Curtis_Bay", "WestStaging",
+                                      "Cancel"};
+const char *const delayMenuItems[] = {"No Delay", "1 Minute", "2 Minutes", "3 Minutes",
+                                      "4 Minutes", "5 Minutes", "6 Minutes", "Cancel"};
+
 void runMENU()  
 {
+  logState(MENU);
+  readAllSens();                          //---sensors stay live in every screen
+  serviceButton();
+  bool trainOut  = ((mainPassByState == 1) && (main_LastDirection == 2)) ||
+                   ((rev_LastDirection == 2) && (revPassByState == 1));
+  bool loopPower = (tracknumActive == ROTARYMAX) && (mapData[crntMap]->revL == true);
+  if((railPower == ON) && (loopPower == false) &&   //---RL power is left on by
+     ((timerTrainIO.running() == false) || trainOut)) //  HOUSEKEEP, not a window
+  {
+    railPower = OFF;                      //---window ran out, outbound train cleared
+    timerTrainIO.disable();               //   the sensor like in TRACK_ACTIVE, or
+    writeRailPower();                     //   doubleclick
+  }
+  if(trainOut == true)
+  {
+    mainPassByState = false;
+    revPassByState  = false;
+  }
+
+  int steps = readEncoderSteps();
+  uint8_t event = u8g2.getMenuEvent();    //---3 button select board
+  if(event == U8X8_MSG_GPIO_MENU_NEXT) steps++;
+  if(event == U8X8_MSG_GPIO_MENU_PREV) steps--;
+  if(event == U8X8_MSG_GPIO_MENU_SELECT) menuSelect = true;
+
+  if(steps != 0)
+  {
+    int cursor = menuCursor + steps;
+    if(cursor < 0) cursor = 0;
+    if(cursor > menuCount() - 1) cursor = menuCount() - 1;
+    menuCursor = cursor;
+    menuDirty  = true;
+  }
+  if(menuSelect == true)
+  {
+    menuSelect = false;
+    menuDirty  = true;
+    if(menuScreen == MENU_MAIN)       runMAINMENU();
+    else if(menuScreen == MENU_YARD)  runYARDMENU();
+    else if(menuScreen == MENU_DELAY) runDELAYMENU();
+  }
+  if((mode == MENU) && menuDirty) drawMenu();
+}
+
+void openMenu()         //---from STAND_BY or TRACK_ACTIVE on a long press
+{
+  menuRequest = false;
+  menuScreen  = MENU_MAIN;
+  menuCursor  = 0;
+  menuSelect  = false;
+  menuDirty   = true;
   oledOn();
-  runMAINMENU();
+  mode = MENU;
+}
+
+int menuCount()
+{
+  if(menuScreen == MENU_YARD)  return sizeof(yardMenuItems)  / sizeof(yardMenuItems[0]);
+  if(menuScreen == MENU_DELAY) return sizeof(delayMenuItems) / sizeof(delayMenuItems[0]);
+  return sizeof(mainMenuItems) / sizeof(mainMenuItems[0]);
+}
+
+void drawMenu()         //---title, then a 4 line window that follows the cursor
+{
+  const char *const *items = mainMenuItems;
+  const char *title = "Select Task";
+  if(menuScreen == MENU_YARD)  { items = yardMenuItems;  title = "Select Yard"; }
+  if(menuScreen == MENU_DELAY) { items = delayMenuItems; title = "Select Delay Min"; }
+
+  int first = menuCursor - 3;
+  if(first < 0) first = 0;
+  u8g2.clearBuffer();
+    u8g2.setFont(u8g2_font_helvB08_te);
+    u8g2.drawStr(3,10, title);
+    u8g2.drawHLine(0, 13, 128);
+    for(int line = 0; (line < 4) && (first + line < menuCount()); line++)
+    {
+      int y = 26 + (line * 12);
+      if(first + line == menuCursor)
+      {
+        u8g2.drawBox(0, y - 10, 128, 12);
+        u8g2.setDrawColor(0);
+      }
+      u8g2.drawStr(6, y, items[first + line]);
+      u8g2.setDrawColor(1);
+    }
+  u8g2.sendBuffer();
+  menuDirty = false;
+}
+
+void closeMenu()
+{
+  mode = HOUSEKEEP;
 }
 
 void runMAINMENU() {
-    int menuSelect = 0;
-    
-    menuSelect = u8g2.userInterfaceSelectionList(
-      "Select Task", 
-      1, 
-      "Yard\n"
-      "Time\n"
-      "Accept & Exit\n"
-      "EXIT"
-      );
-
-    if     (menuSelect == 1) runYARDMENU();  
-    else if(menuSelect == 2) runDELAYMENU();  
-    else if(menuSelect == 3) {
-      EEPROM.write(0, crntMapChoice);         //---Write new yard selection to eeprom
-      EEPROM.commit();
-      EEPROM.write(1, trackActiveDelayChoice);//---Write new delay time
-      EEPROM.commit();
-      runHOUSEKEEP();
+    if     (menuCursor == 0) { menuScreen = MENU_YARD;  menuCursor = crntMapChoice; }
+    else if(menuCursor == 1) {
+      menuScreen = MENU_DELAY;                //---a window longer than the list,
+      menuCursor = trackActiveDelayChoice;    //   set over "C", opens on Cancel
+      if(menuCursor > menuCount() - 1) menuCursor = menuCount() - 1;
+    }
+    else if(menuCursor == 2) {
+      configIncoming = config;
+      configIncoming.crntMap = crntMapChoice; //---new yard selection
+      configIncoming.yardDelay[crntMapChoice] = trackActiveDelayChoice;  //---its delay time
+      configRequest = true;                   //---live, no reboot: STAND_BY applies it
+      closeMenu();                            //   like "C", never with a train on the lead
     }  
-    else if(menuSelect == 4) {
+    else if(menuCursor == 3) {
       crntMapChoice = crntMap;
       trackActiveDelayChoice = trackActiveDelay;
-      runHOUSEKEEP();
+      closeMenu();
     }
   }
 
  void runYARDMENU() {          //---select the yard for this board
-    int yardSelect = 0;
-    
-    yardSelect = u8g2.userInterfaceSelectionList(
-      "Select Yard", 
-      1, 
-      "Wheeling\n"    
-      "Parkersburg\n" 
-      "Bayview\n"
-      "Cumberland\n"
-      "Test\n"
-      "Charleston\n"
-      "Curtis_Bay\n"
-      "WestStaging\n"
-      "Cancel"
-      );
-
-    if (yardSelect >= 1 && yardSelect < 9) {
-      crntMapChoice = yardSelect - 1;
-      runMAINMENU();
-      
+    if (menuCursor < 8) {
+      crntMapChoice = menuCursor;
+      trackActiveDelayChoice = config.yardDelay[crntMapChoice];  //---yard's own delay
     }
-    else if (yardSelect == 8) runMAINMENU();
+    menuScreen = MENU_MAIN;       //---choice or cancel: back to the main list
+    menuCursor = 0;
   }
 
   void runDELAYMENU() {       //---select the delay time for this board
-    int delaySelect = 0;
-    delaySelect = u8g2.userInterfaceSelectionList(
-      "Select Delay Min", 
-      1, 
-      "No Delay\n"
-      "1 Minute\n"
-      "2 Minutes\n"
-      "3 Minutes\n"
-      "4 Minutes\n"
-      "5 Minutes\n"
-      "6 Minutes\n"
-      "Cancel"
-      );
-
-    if (delaySelect >= 1 && delaySelect <8) {   
-      trackActiveDelayChoice = delaySelect - 1;
-      runMAINMENU();
-      
+    if (menuCursor < 7) {   
+      trackActiveDelayChoice = menuCursor;
     }
-    else if (delaySelect == 8) runMAINMENU();  //---if choice is cancel: bail
+    menuScreen = MENU_MAIN;       //---if choice is cancel: bail
+    menuCursor = 1;
   }
 //-----END runMENU FUNCTIONS------------------------------------------
 
@@ -932,121 +1464,30 @@ void runMAINMENU() {
 
 void readAllSens() 
   {
+    tracePoll();
     readMainSens();
     readRevSens();
+    servicePower();
   }   
 
 void readMainSens() {
-  debouncer1.update();  
-  int mainInValue = debouncer1.read();
-   if(mainInValue != mainIn_LastValue)
-   {
-      if(mainInValue == 0) bitSet(mainSens_Report, 0);
-      else bitClear(mainSens_Report, 0); 
-      mainIn_LastValue = mainInValue;
-      if (mainSens_Report > 0) 
-      {
-        mainSensTotal = mainSensTotal + mainSens_Report;
-        mainPassByTotal = mainSensTotal;
-      }
-      else mainSensTotal = 0;   
-    }
-  debouncer2.update();                 //--read mainOut sensor
-  int mainOutValue = debouncer2.read();
-                                       //--update history register: *Sens_Report    
-  if(mainOutValue != mainOut_LastValue)   
-    {
-      if(mainOutValue == 0) bitSet(mainSens_Report, 1);
-      else bitClear(mainSens_Report, 1); 
-
-      mainOut_LastValue = mainOutValue;
-                                        /*--add running total to "*"SensTotal to 
-                                        track PassBy status                    */
-      if (mainSens_Report > 0) 
-      {
-        mainSensTotal = mainSensTotal + mainSens_Report;
-        mainPassByTotal = mainSensTotal;
-      }
-      else mainSensTotal = 0; 
-    }
-    //---PassByTotal greater than "6" means train has cleared the sensor 
-    //  successfully.  TODO--TODO--TODO  FIX BACKING OUT PROBLEM WHEN STARTING
-    //  ENTERING OUTBOUND AND BACKING OUT INBOUND - TURNS OFF TIMER
-    //---------end of note------
-
-    if(mainSensTotal == 0 && mainPassByTotal >= 6) 
-      {
-       mainPassByState = true;
-       mainPassByTotal = 0;
-      }
-    else if(mainSensTotal == 0) mainPassByTotal = 0;
-    if((mainSensTotal == 2) && (mainSens_Report == 2)) //--report mainLine Direction
-    { 
-      mainDirection = 2;
-      main_LastDirection = 2;
-    }
-    else if((mainSensTotal == 1) && (mainSens_Report == 1)) 
-    {
-      mainDirection = 1;
-      main_LastDirection = 1;
-    }
-    if((mainSensTotal == 0) && (mainSens_Report == 0)) 
-    {
-     mainDirection = 0;
-    } 
+  byte before = mainSens_Report;
+  debouncer1.update();                 //--mainIn sensor
+  debouncer2.update();                 //--mainOut sensor
+  if(sensorPairUpdate(mainPair, debouncer1.read(), debouncer2.read()))
+  {                                    //--train went all the way through
+    trackOccupancyEvent(main_LastDirection);
+  }
+  if(mainSens_Report != before) LOG_SENSOR(0, mainSens_Report, mainDirection, mainPassByState);
 }  // end readMainSen--
 
 void readRevSens() 
 { 
-  debouncer3.update();
-  int revInValue = debouncer3.read();
-  if(revInValue != revIn_LastValue)     
-  {
-    if(revInValue == 0) bitSet(revSens_Report, 0);
-    else bitClear(revSens_Report, 0); 
-    revIn_LastValue = revInValue;
-     if (revSens_Report > 0) 
-    {
-      revSensTotal = revSensTotal + revSens_Report;
-      revPassByTotal = revSensTotal;
-    }
-    else revSensTotal = 0;   
-  }
-      
-  debouncer4.update();
-  int revOutValue = debouncer4.read();
-   if(revOutValue != revOut_LastValue)     
-  {
-    if(revOutValue == 0) bitSet(revSens_Report, 1);
-    else bitClear(revSens_Report, 1); 
-    revOut_LastValue = revOutValue;
-    if (revSens_Report > 0) 
-    {
-      revSensTotal = revSensTotal + revSens_Report;
-      revPassByTotal = revSensTotal;
-    }
-    else revSensTotal = 0; 
-  }
-    if(revSensTotal == 0 && revPassByTotal >= 6) 
-    {
-      revPassByState = true;
-      revPassByTotal = 0;
-    }
-    else if(revSensTotal == 0) revPassByTotal = 0;
-    if((revSensTotal == 2) && (revSens_Report == 2)) //--report revLoop Direction
-    {
-      revDirection = 2;
-      rev_LastDirection = 2;
-    }
-    else if((revSensTotal == 1) && (revSens_Report == 1)) 
-    {
-      revDirection = 1;
-      rev_LastDirection = 1;
-    }
-    if((revSensTotal == 0) && (revSens_Report == 0)) 
-    {
-      revDirection = 0;
-    }
+  byte before = revSens_Report;
+  debouncer3.update();                 //--revIn sensor
+  debouncer4.update();                 //--revOut sensor
+  sensorPairUpdate(revPair, debouncer3.read(), debouncer4.read());
+  if(revSens_Report != before) LOG_SENSOR(1, revSens_Report, revDirection, revPassByState);
 }  // end readrevSen--
 
 // -----------------------DISPLAY FUNCTIONS---------------------//
@@ -1093,6 +1534,42 @@ void tracknumActChoText()
     else u8g2.drawStr(72,40,choiceBuf);   
 }  
 
+void routeDiffText()    //---turnouts to move and alignment time vs latched route
+{
+  byte moves = routeDiff[tracknumAligned][tracknumChoice];
+  enum {BufSize=32};                      //--"255 sw  ", every digit of an unsigned long
+  char diffBuf[BufSize];
+  diffShownSecs = alignSeconds();
+  if(diffShownSecs == 0) snprintf(diffBuf, BufSize, "Aligned");
+  else if(moves == 0) snprintf(diffBuf, BufSize, "Aligning %lus", diffShownSecs);
+  else snprintf(diffBuf, BufSize, "%d sw  %lus", moves, diffShownSecs);
+  u8g2.setFont(u8g2_font_helvR08_te);
+  u8g2.drawStr(3,35, diffBuf);
+}
+
+unsigned long alignSeconds()   //--until the choice is aligned, rounded up: what
+{                              //  a pre-align still has to run, else a full move
+  bcsjTime64 left = interval_Tortoise;
+  if(tracknumChoice == tracknumAligned)
+  {
+    left = timerTortoise.running() ? interval_Tortoise - timerTortoise.delta() : 0;
+  }
+  return (unsigned long)((left + bcsjSeconds(1) - 1) / bcsjSeconds(1));
+}
+
+void occupancyText()    //---one box per staging track across the top right, 
+{                       //   filled when the track holds a train
+  const turnoutMap *yard = mapData[crntMap];
+  byte x = 72;
+  for(uint16_t trk = yard->startTrack; trk <= yard->numTracks; trk++)
+  {
+    if(isStagingTrack(trk) == false) continue;
+    if(isOccupied(trk)) u8g2.drawBox(x, 0, 2, 3);
+    else u8g2.drawFrame(x, 0, 2, 3);
+    x += 3;
+  }
+}
+
 void oledOn()
  {
   u8g2.setPowerSave(0);
@@ -1111,7 +1588,10 @@ void oledOff()
 //----------------------------------------------------------------//
 
 void click1(){                //--singleclick: if sleeping: awaken OLED  
-  if(oledState == false){
+  if(mode == MENU){
+    menuSelect = true;        //  in the menu: pick the highlighted line
+  }
+  else if(oledState == false){
     timerOLED.start(interval_OLED);
     oledOn();
     u8g2.sendBuffer();
@@ -1121,24 +1601,707 @@ void click1(){                //--singleclick: if sleeping: awaken OLED
 
 void doubleclick1(){          //--doubleclick: reset trainIO timer to 0
     timerTrainIO.disable();
+    bailOut = false;          //  and flag it, in case the timer is not running yet
 }
 
 void longPressStart1(){       //--hold for 6 seconds: goto Main Setup Menu
-    runMENU();
+    if(mode != MENU) menuRequest = true;  //--STAND_BY or TRACK_ACTIVE opens it
+}
+
+void IRAM_ATTR encoderSwISR() //--every switch edge, timestamped, to the decoder
+{
+  encoderSw.edge(digitalRead(encoderSwPin) == LOW, bcsjNow());
+  idleNotifyFromISR();
+}
+
+void serviceButton()          //--run the gestures queued since the last call, 
+{                             //  called from every state loop
+  serviceSerial();            //--commands queue theirs here too
+  encoderSw.update(bcsjNow());
+  uint8_t gesture;
+  while((gesture = encoderSw.next()) != BTN_NONE)
+  {
+    if(gesture == BTN_CLICK)            click1();
+    else if(gesture == BTN_DOUBLECLICK) doubleclick1();
+    else if(gesture == BTN_LONGPRESS)   longPressStart1();
+  }
+}
+
+//----------------------IDLE FUNCTIONS----------------------------//
+//  Every input pin raises a bit in idleEvents from its interrupt.  //
+//  The serial line raises it too, from its receive callback.      //
+//  STAND_BY blocks on the group once all inputs have been quiet   //
+//  for idleHoldoff, so debouncing and click timing still run      //
+//  flat out.  Automatic light sleep then stops the cores until a  //
+//  GPIO level wakes them or the next bcsjTimers deadline is due,  //
+//  if the core was built with CONFIG_PM_ENABLE.  The stock        //
+//  Arduino core is not: esp_pm_configure() refuses and the block  //
+//  just leaves the cores in the idle task's WFI.                  //
+//----------------------------------------------------------------//
+
+#if IDLE_LIGHT_SLEEP && defined(ARDUINO_ARCH_ESP32)
+
+#define IDLE_EV_INPUT  (1 << 0)
+
+EventGroupHandle_t idleEvents;
+portMUX_TYPE idleMux = portMUX_INITIALIZER_UNLOCKED;
+DRAM_ATTR const byte idlePins[] = {encoderPinA, encoderPinB, encoderSwPin, 
+                         mainSensInpin, mainSensOutpin, revSensInpin, revSensOutpin};
+
+//--gpio_wakeup_enable() also switches each pin's interrupt from CHANGE to
+//  the wake level, and gpio_wakeup_disable() does not put it back.  Left
+//  that way the ISRs fire nonstop on a held beam or switch, so the first
+//  one to fire after arming, or the end of the wait, sets every pin back
+//  to edges.  The register write is inline, safe from an ISR.  Only the
+//  board shows this, the host shim has no interrupt types.
+volatile bool idleLevelArmed = false;
+
+void IRAM_ATTR idleEdgeTriggers()
+{
+  for(byte pin : idlePins) gpio_ll_set_intr_type(&GPIO, pin, GPIO_INTR_ANYEDGE);
+  idleLevelArmed = false;
+}
+
+void IRAM_ATTR idleNotifyFromISR()
+{
+  BaseType_t woken = pdFALSE;
+  bcsjTime64 now = bcsjNow();
+  if(idleLevelArmed) idleEdgeTriggers();
+  if(idleEdgeStamp == 0) idleEdgeStamp = now;
+  idleLastEdge = now;
+  xEventGroupSetBitsFromISR(idleEvents, IDLE_EV_INPUT, &woken);
+  if(woken == pdTRUE) portYIELD_FROM_ISR();
+}
+
+void IRAM_ATTR idleInputISR()
+{
+  idleNotifyFromISR();
+}
+
+void idleNotifyFromTask()                 //--UART event task or the power stage's
+{                                         //  timer, not an ISR: a command or a 
+                                          //  trip ends the block at once
+  xEventGroupSetBits(idleEvents, IDLE_EV_INPUT);
+}
+
+void idleSetup()
+{
+  idleEvents = xEventGroupCreate();
+  for(byte pin : idlePins)
+  {
+    if(pin == encoderSwPin) continue;     //--encoderSwISR notifies for the switch
+    attachInterrupt(digitalPinToInterrupt(pin), idleInputISR, CHANGE);
+  }
+  esp_sleep_enable_gpio_wakeup();
+  Serial.onReceive(idleNotifyFromTask);
+  uart_set_wakeup_threshold(UART_NUM_0, 3);  //--RX edges wake light sleep too; 
+  esp_sleep_enable_uart_wakeup(0);           //  the character that wakes it is 
+                                             //  lost, yardCtl.py sends a blank
+                                             //  line ahead of each command
+
+  esp_pm_config_esp32_t pm = {};          //--needs CONFIG_PM_ENABLE and tickless 
+  pm.max_freq_mhz = 240;                  //  idle, which the stock Arduino core 
+  pm.min_freq_mhz = 80;                   //  lacks: the block still idles the 
+                                          //  cores, without sleeping
+  pm.light_sleep_enable = true;
+  if(esp_pm_configure(&pm) != ESP_OK) LOG_W("IDLE: light sleep not available");
+}
+
+void idleWait()
+{
+  if((mainSens_Report > 0) || (revSens_Report > 0)) return;  //--train at a sensor
+  if(encoderSw.pressed()) return;                            //--long press timing
+  if(Serial.available() > 0) return;                         //--rest of a command
+  if((bcsjNow() - idleLastEdge) < idleHoldoff) return;       //--gesture in progress
+
+  portENTER_CRITICAL(&idleMux);           //--armed all at once, or a pin that 
+  idleLevelArmed = true;                  //  moves midway is missed by the ISR
+  for(byte pin : idlePins)                //--wake on the level each pin is not at
+  {
+    gpio_wakeup_enable((gpio_num_t)pin, 
+                       digitalRead(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  }
+  portEXIT_CRITICAL(&idleMux);
+  bcsjTime64 wait = bcsjTimers.untilNext();
+  if(wait > idleMaxBlock) wait = idleMaxBlock;
+  idleEdgeStamp = 0;
+  idleBlocked   = true;
+  xEventGroupClearBits(idleEvents, IDLE_EV_INPUT);
+  xEventGroupWaitBits(idleEvents, IDLE_EV_INPUT, pdTRUE, pdFALSE, 
+                      pdMS_TO_TICKS(wait / 1000) + 1);
+  portENTER_CRITICAL(&idleMux);
+  for(byte pin : idlePins) gpio_wakeup_disable((gpio_num_t)pin);
+  idleEdgeTriggers();                     //--timer wake, no ISR has done it
+  portEXIT_CRITICAL(&idleMux);
+  bcsjTimers.poll();
+}
+
+#else
+
+void idleSetup() {}
+void idleWait()  {}
+void idleNotifyFromISR() {}
+void idleNotifyFromTask() {}
+
+#endif
+
+void idleResponded()    //--after one pass of the input pollers following a wake
+{
+  if(idleBlocked == false) return;
+  idleBlocked = false;
+  if(idleEdgeStamp == 0) return;          //--timer wake, nothing to measure
+  idleLatencyLast = bcsjNow() - idleEdgeStamp;
+  idleWakeCount++;
+  if(idleLatencyLast > idleLatencyMax)    //--report only a new worst case
+  {
+    idleLatencyMax = idleLatencyLast;
+    LOG_TIMING(LOG_T_IDLE_WAKE, idleLatencyMax);
+  }
+}
+
+//----------------SERIAL COMMAND FUNCTIONS------------------------//
+//  One command per line, ended by CR or LF, either case.         //
+//  Actions go in as the panel's own gestures and knob moves, so  //
+//  the state machine treats them exactly as it treats the        //
+//  operator; each gets "OK" or "ERR why".  A query gets its one  //
+//  line instead.                                                 //
+//                                                                //
+//    S n    turn the knob to track n                STAND_BY     //
+//    A [n]  click, after turning to n if given      STAND_BY     //
+//    E      click during a move: one more window    TRACK_SETUP, //
+//           on the same track once this one ends    TRACK_ACTIVE //
+//    X      double click: cut the power window      any          //
+//    M      MODE state, yard, tracks, power, occupancy           //
+//    I      SENS both sensor pairs                               //
+//    P      STATS boot, flash and idle timings                   //
+//    C      CONFIG the yardConfig record in hex                  //
+//    C hex  load a sealed record, as Accept & Exit  idle         //
+//    B      sensor storm benchmark, if built in     idle         //
+//    T      input trace, if built in                idle         //
+//                                                                //
+//  With POWER_DISTRICTS, S and A also work in TRACK_ACTIVE: the  //
+//  next move starts once this window's inbound train is through  //
+//  and ladderClearSec on, else when the window ends.             //
+//  When skipOccupied steers n off an occupied track, as the knob //
+//  would, the reply is "ERR occupied" and A does not click.      //
+//                                                                //
+//  Idle is STAND_BY with both sensors clear.  Replies are text   //
+//  between telemetry frames; tools/yardCtl.py sends and reads.   //
+//----------------------------------------------------------------//
+
+void serviceSerial()          //--gather a line from whatever has arrived, run 
+{                             //  it at CR or LF; never waits for the rest
+  while(Serial.available() > 0)
+  {
+    char c = Serial.read();
+    if((c == '\r') || (c == '\n'))
+    {
+      serialLine[serialLen] = 0;
+      if(serialOverrun == true) serialReply("ERR long");
+      else if(serialLen > 0)    serialCommand(serialLine);
+      serialLen     = 0;
+      serialOverrun = false;
+    }
+    else if(serialLen < SERIAL_LINE - 1) serialLine[serialLen++] = c;
+    else serialOverrun = true;
+  }
+}
+
+void serialCommand(char *line)
+{
+  const char *const dirNames[] = {"-", "IN", "OUT"};
+  char  command = toupper(line[0]);
+  char *rest    = line + 1;
+  while(*rest == ' ') rest++;
+  bool  hasArg  = (*rest != 0);
+  long  arg     = strtol(rest, NULL, 10);
+  char  reply[128];
+
+  if((command == 'S') || (command == 'A'))
+  {
+    if((mode != STAND_BY) && ((POWER_DISTRICTS == 0) || (mode != TRACK_ACTIVE))) 
+    {
+      serialReply("ERR mode");
+    }
+    else if((command == 'S') && (hasArg == false)) serialReply("ERR track");
+    else if(hasArg && ((arg < ROTARYMIN) || (arg > ROTARYMAX))) serialReply("ERR track");
+    else
+    {
+      if(hasArg) moveChoice(arg);                //--skipOccupied applies, as on the knob
+      traceRemote(command, hasArg ? arg : 0xFF);
+      if(hasArg && (tracknumChoice != arg)) serialReply("ERR occupied");
+      else
+      {
+        if(command == 'A') encoderSw.inject(BTN_CLICK);
+        serialReply("OK");
+      }
+    }
+  }
+  else if(command == 'E')
+  {
+    if((mode != TRACK_SETUP) && (mode != TRACK_ACTIVE)) serialReply("ERR mode");
+    else
+    {
+      encoderSw.inject(BTN_CLICK);
+      traceRemote(command, 0xFF);
+      serialReply("OK");
+    }
+  }
+  else if(command == 'X')
+  {
+    encoderSw.inject(BTN_DOUBLECLICK);
+    traceRemote(command, 0xFF);
+    serialReply("OK");
+  }
+  else if(command == 'M')                  //--modeLogged also knows OCCUPIED
+  {
+    byte now = (modeLogged < 8) ? modeLogged : (byte)mode;
+    snprintf(reply, sizeof(reply), "MODE %s yard %s choice %u active %u aligned %u power %s occ %08lx",
+             modeNames[now], mapData[crntMap]->mapName, tracknumChoice, tracknumActive,
+             tracknumAligned, tripShown ? "TRIP" : ((railPower == ON) ? "ON" : "OFF"),
+             (unsigned long)yardOccupancy[crntMap]);
+    serialReply(reply);
+  }
+  else if(command == 'I')
+  {
+    snprintf(reply, sizeof(reply), "SENS main %u%u %s passby %u rev %u%u %s passby %u",
+             (mainSens_Report >> 1) & 1, mainSens_Report & 1, dirNames[mainDirection % 3],
+             mainPassByState, (revSens_Report >> 1) & 1, revSens_Report & 1,
+             dirNames[revDirection % 3], revPassByState);
+    serialReply(reply);
+  }
+  else if(command == 'P')
+  {
+    snprintf(reply, sizeof(reply), 
+             "STATS boot_us %lu flash_us %lu flash_max_us %lu wakes %lu wake_us %lu wake_max_us %lu lost %u",
+             (unsigned long)bootFirstSample, (unsigned long)flashStallLast,
+             (unsigned long)flashStallMax, (unsigned long)idleWakeCount, 
+             (unsigned long)idleLatencyLast, (unsigned long)idleLatencyMax, encoderSw.dropped());
+    serialReply(reply);
+  }
+  else if((command == 'C') && (hasArg == false))
+  {
+    yardConfig current = config;           //--sealed only when written
+    configSeal(current);
+    const uint8_t *raw = (const uint8_t *)&current;
+    char *at = reply + snprintf(reply, sizeof(reply), "CONFIG ");
+    for(byte i = 0; i < sizeof(current); i++) at += snprintf(at, 3, "%02X", raw[i]);
+    serialReply(reply);
+  }
+  else if(command == 'C')
+  {
+    uint8_t *raw = (uint8_t *)&configIncoming;
+    bool ok = (strlen(rest) == 2 * sizeof(configIncoming));
+    for(byte i = 0; ok && (i < sizeof(configIncoming)); i++)
+    {
+      char  pair[3] = {rest[2 * i], rest[2 * i + 1], 0};
+      char *end;
+      raw[i] = strtoul(pair, &end, 16);
+      ok = (end == pair + 2);
+    }
+    if((ok == false) || (configValid(configIncoming) == false)) serialReply("ERR config");
+    else if(yardIdle() == false) serialReply("ERR busy");
+    else
+    {
+      configRequest = true;                //--STAND_BY takes it at its next pass
+      serialReply("OK");
+    }
+  }
+#if SENSOR_BENCH
+  else if(command == 'B')                  //--every storm case
+  {
+    if(yardIdle() == false) serialReply("ERR busy");
+    else
+    {
+      for(uint8_t id = 0; id < STORM_CASES; id++) benchRun(id);
+      serialReply("OK");
+    }
+  }
+#endif
+#if TRACE_CAPTURE
+  else if(command == 'T')                  //--the trace since boot, one binary frame
+  {
+    if(yardIdle() == false) serialReply("ERR busy");
+    else
+    {
+      LOG_FLUSH();
+      trace.dump(traceWrite, bcsjNow());
+      serialReply("OK");
+    }
+  }
+#endif
+  else serialReply("ERR command");
+}
+
+void serialReply(const char *text)
+{
+  LOG_FLUSH();                //--replies go out between whole frames
+  Serial.println(text);
+}
+
+bool yardIdle()               //--nothing moving: safe to block or reconfigure
+{
+  return (mode == STAND_BY) && (mainSens_Report == 0) && (revSens_Report == 0);
+}
+
+//----------------Sensor Storm Benchmark--------------//
+
+void benchRun(uint8_t id)     //--one case through the real sensor readers
+{
+#if SENSOR_BENCH
+  uint32_t occupancy[8];                  //--scripted trains are not real ones,
+  byte     pending = flashPending;        //  put occupancy back afterwards
+  memcpy(occupancy, yardOccupancy, sizeof(occupancy));
+
+  storm.begin(id, bcsjNow(), bcsjMillis(config.debounceMs) * 2);
+  benchPassBy = false;
+  while(storm.done(bcsjNow()) == false)
+  {
+    readAllSens();
+    storm.observe((mainSens_Report & 3) | ((revSens_Report & 3) << 2), bcsjNow());
+    if(mainPassByState || revPassByState) benchPassBy = true;
+#if defined(BCSJ_VIRTUAL_CLOCK)
+    bcsjClockAdvance(BENCH_HOST_PASS);    //--host time only moves when told
+#endif
+  }
+  storm.end();
+  memcpy(yardOccupancy, occupancy, sizeof(occupancy));
+  flashPending    = pending;
+  mainPassByState = false;
+  revPassByState  = false;
+
+  stormResult &r = storm.result;
+  LOG_FLUSH();
+  Serial.print("BENCH ");        Serial.print(storm.name(id));
+  Serial.print(" settled ");     Serial.print(r.settled);
+  Serial.print(" seen ");        Serial.print(r.seen);
+  Serial.print(" missed ");      Serial.print(r.missed);
+  Serial.print(" spurious ");    Serial.print(r.spurious);
+  Serial.print(" lat_avg_us ");  Serial.print((unsigned long)(r.seen ? r.latencySum / r.seen : 0));
+  Serial.print(" lat_max_us ");  Serial.print((unsigned long)r.latencyMax);
+  Serial.print(" pass_us ");     Serial.print((unsigned long)(r.passes ? r.elapsed / r.passes : 0));
+  Serial.print(" passby ");      Serial.println(benchPassBy ? "yes" : "no");
+#endif
+}
+
+//----------------Input Trace--------------//
+
+#if TRACE_CAPTURE
+const byte tracePins[] = {mainSensInpin, mainSensOutpin, revSensInpin, revSensOutpin,
+                          encoderPinA, encoderPinB, encoderSwPin};
+byte traceLevels[sizeof(tracePins)];
+byte traceMode  = 0xFF;
+byte tracePower = 0xFF;
+#endif
+
+void traceStart()             //--from setup(), with the NVS state it booted from
+{
+#if TRACE_CAPTURE
+  yardConfig booted = config;             //--defaults are not sealed until saved
+  configSeal(booted);
+  nvsBlob blobs[] = {{YARD_CONFIG_KEY, &booted, sizeof(booted)},
+                     {OCC_NVS_KEY, yardOccupancy, sizeof(yardOccupancy)}};
+  trace.begin(blobs, 2, bcsjNow());
+  memset(traceLevels, 0xFF, sizeof(traceLevels));   //--first pass logs every pin
+  traceMode  = 0xFF;
+  tracePower = LOW;                       //--relay is off out of reset
+#endif
+}
+
+void tracePoll()              //--input edges and output changes since the last 
+{                             //  pass; the switch too, at the rate it is polled
+#if TRACE_CAPTURE
+  bcsjTime64 now = bcsjNow();
+  for(byte i = 0; i < sizeof(tracePins); i++)
+  {
+    byte level = digitalRead(tracePins[i]);
+    if(level == traceLevels[i]) continue;
+    traceLevels[i] = level;
+    trace.log(TRACE_PIN, tracePins[i], level, now);
+  }
+#if POWER_STAGE
+  byte power = powerLevel;                          //--commanded, a PWM gate has no level
+#else
+  byte power = digitalRead(trackPowerLED_PIN);      //--OUTPUT reads back on the ESP32
+#endif
+  if(power != tracePower)
+  {
+    tracePower = power;
+    trace.log(TRACE_POWER, 0, power, now);
+  }
+  if(mode != traceMode)
+  {
+    traceMode = mode;
+    trace.log(TRACE_MODE, 0, mode, now);
+  }
+#endif
+}
+
+void traceRemote(char command, byte arg)   //--a serial action goes in with the 
+{                                          //  pin edges, the replay types it again
+#if TRACE_CAPTURE
+  trace.log(TRACE_PIN, TRACE_REMOTE, ((uint16_t)command << 8) | arg, bcsjNow());
+#endif
+}
+
+void traceWrite(uint8_t c)
+{
+  Serial.write(c);
+}
+
+//----------------Track Power Functions--------------//
+
+void powerOut(byte level)     //--every write to track power goes through here
+{
+  powerLevel = level;
+#if POWER_DISTRICTS
+  writeDistricts((level == HIGH) ? (1UL << tracknumAligned) : 0);  //--parked 
+#endif                                                             //  tracks dead
+#if POWER_STAGE
+  powerStage.set(level);      //--ramps up on HIGH, a trip also clears on HIGH
+#else
+  digitalWrite(trackPowerLED_PIN, level);
+#endif
+}
+
+void writeRailPower()
+{
+  powerOut((railPower == ON) ? HIGH : LOW);
+}
+
+void servicePower()           //--the stage has already cut the gate from its
+{                             //  timer; the state machine hears of it here
+#if POWER_STAGE
+  byte reason = powerStage.tripped();
+  if(reason == tripShown) return;
+  tripShown = reason;
+  if(reason == TRIP_NONE) return;
+
+  railPower = OFF;            //--ends the window like a doubleclick: back to
+  powerOut(LOW);              //  STAND_BY, a click tries again
+  timerTrainIO.disable();
+  bailOut = false;
+  LOG_TIMING(LOG_T_POWER_TRIP, powerStage.tripUs());
+  LOG_W("POWER: overcurrent trip");
+
+  oledOn();
+  u8g2.setDrawColor(0);
+  u8g2.drawBox(0, 47, 128, 17);
+  u8g2.setDrawColor(1);
+  u8g2.setFont(u8g2_font_helvB10_te);
+  u8g2.drawStr(3,61,powerText());
+  u8g2.sendBuffer();
+#endif
+}
+
+const char *powerText()       //--bottom line of the screens that show power
+{
+#if POWER_STAGE
+  static char text[24];
+  if(powerStage.tripped() == TRIP_OVERCURRENT)
+  {
+    snprintf(text, sizeof(text), "SHORT %u.%uA - off", 
+             powerStage.tripMa() / 1000, (powerStage.tripMa() % 1000) / 100);
+    return text;
+  }
+#endif
+  return (railPower == ON) ? "Track power ON" : "Track power OFF";
 }
 
 //----------------Shift Register Function--------------//
 
 void writeTrackBits(uint16_t track)
 {
+#if TRACE_CAPTURE
+  trace.log(TRACE_ROUTE, 0, track, bcsjNow());
+#endif
+  routeLatched = track;
+  shiftRegisters();
+}  
+
+void shiftRegisters()   //--the district stage sits furthest down the chain, 
+{                       //  so its bytes go out first
   digitalWrite(latchPin, LOW);
-  shiftOut(dataPin, clockPin, MSBFIRST, (track >> 8));
-  shiftOut(dataPin, clockPin, MSBFIRST, track);
+#if POWER_DISTRICTS
+  for(int8_t b = DISTRICT_BYTES - 1; b >= 0; b--)
+  {
+    shiftOut(dataPin, clockPin, MSBFIRST, districtBits >> (8 * b));
+  }
+#endif
+  shiftOut(dataPin, clockPin, MSBFIRST, (routeLatched >> 8));
+  shiftOut(dataPin, clockPin, MSBFIRST, routeLatched);
   digitalWrite(latchPin, HIGH);
-            /*/--DEBUG: 
-            Serial.print("trackFunction: ");
-            Serial.println(track);
-            Serial.println(track, BIN);  */
-}  
+}
+
+void writeDistricts(uint32_t bits)   //--latched again only when they change,
+{                                    //  the turnout word goes out unchanged
+  if(bits == districtBits) return;
+  districtBits = bits;
+  shiftRegisters();
+}
+
+//----------------Route Alignment Functions--------------//
+
+void alignTrack(uint16_t trackNum)  //--latch route and time the Tortoise travel
+{
+  writeTrackBits(mapData[crntMap]->routes[trackNum]);
+  LOG_ROUTE(trackNum, mapData[crntMap]->routes[trackNum]);
+  tracknumAligned = trackNum;
+  timerTortoise.start(interval_Tortoise);
+}
+
+void buildRouteDiff()   //--popcount of route XOR for every pair of tracks
+{
+  const turnoutMap *yard = mapData[crntMap];
+  for(byte from = 0; from <= yard->numTracks; from++)
+  {
+    for(byte to = 0; to <= yard->numTracks; to++)
+    {
+      routeDiff[from][to] = __builtin_popcount(yard->routes[from] ^ yard->routes[to]);
+    }
+  }
+}
+
+//----------------Yard Occupancy Functions--------------//
+
+bool isStagingTrack(uint16_t trackNum)   //--the reverse loop is not a staging track
+{
+  const turnoutMap *yard = mapData[crntMap];
+  if((trackNum < yard->startTrack) || (trackNum > yard->numTracks)) return false;
+  if((trackNum == yard->numTracks) && (yard->revL == true)) return false;
+  return true;
+}
+
+bool isOccupied(uint16_t trackNum)
+{
+  if(isStagingTrack(trackNum) == false) return false;
+  return bitRead(yardOccupancy[crntMap], trackNum);
+}
+
+void trackOccupancyEvent(byte direction)  //--called on a mainSens PassBy
+{
+  if(isStagingTrack(tracknumAligned) == false) return;
+  uint32_t before = yardOccupancy[crntMap];
+  if(direction == INBOUND)       bitSet(yardOccupancy[crntMap], tracknumAligned);
+  else if(direction == OUTBOUND) bitClear(yardOccupancy[crntMap], tracknumAligned);
+  if(yardOccupancy[crntMap] != before) saveOccupancy();
+}
+
+void saveOccupancy()
+{
+  flashDefer(FLASH_OCCUPANCY);
+}
+
+//----------------Flash Commit Functions--------------//
+
+void flashDefer(byte what)    //--queue a write for serviceFlash()
+{
+  flashPending |= what;
+}
+
+void serviceFlash()           //--write everything pending in one commit, but only
+{                             //  when the cache stall cannot delay a sensor or a
+  if(flashPending == 0) return;                              //  powered move
+  if((mainSens_Report > 0) || (revSens_Report > 0)) return;
+  if(railPower == ON) return;
+  if(timerFlashRetry.running()) return;
+
+  nvsBlob blobs[2];
+  byte count = 0;
+  if(flashPending & FLASH_CONFIG)
+  {
+    configSeal(config);
+    blobs[count++] = {YARD_CONFIG_KEY, &config, sizeof(config)};
+  }
+  if(flashPending & FLASH_OCCUPANCY)
+  {
+    blobs[count++] = {OCC_NVS_KEY, yardOccupancy, sizeof(yardOccupancy)};
+  }
+  bcsjTime64 start = bcsjNow();
+  if(nvsWriteBlobs(blobs, count) == true)
+  {
+    flashPending = 0;
+    timerFlashRetry.disable();
+  }
+  else                                  //--still pending: tried again once the
+  {                                     //  retry timer is out, only the first
+                                        //  failure in a row is logged
+    if(timerFlashRetry.done() == false) LOG_E("FLASH: NVS write failed, retrying");
+    timerFlashRetry.start(interval_FlashRetry);
+  }
+  flashStallLast = bcsjNow() - start;
+  if(flashStallLast > flashStallMax) flashStallMax = flashStallLast;
+  LOG_TIMING(LOG_T_FLASH_COMMIT, flashStallLast);
+}
+
+//----------------Config Functions--------------//
+
+void useConfig()        //--copy the yardConfig record into the working variables
+{
+  crntMap              = config.crntMap;
+  trackActiveDelay     = config.yardDelay[crntMap];
+  interval_Tortoise    = bcsjMillis(config.tortoiseMs);
+  additionalScreenTime = bcsjSeconds(config.screenTimeoutSec);
+  interval_OLED        = bcsjMinutes(trackActiveDelay) + additionalScreenTime;
+  interval_PreAlign    = bcsjMillis(config.preAlignMs);
+  preAlignEnabled      = (config.flags & CFG_PREALIGN)     != 0;
+  autoRouteEnabled     = (config.flags & CFG_AUTOROUTE)    != 0;
+  autoRevLoopEnabled   = (config.flags & CFG_AUTOREVLOOP)  != 0;
+  skipOccupied         = (config.flags & CFG_SKIPOCCUPIED) != 0;
+  autoRoutePolicy      = (autoPolicy)config.autoRoutePolicy;
+  ladderClear          = bcsjSeconds(config.ladderClearSec);
+}
+
+void reconfigure()      //--switch to the settings in config in one step: power 
+{                       //  off, new map and timers, default track aligned
+  railPower = OFF;
+  powerOut(LOW);
+  timerTrainIO.disable();
+  timerPreAlign.disable();
+
+  useConfig();
+  debouncer1.interval(config.debounceMs); debouncer2.interval(config.debounceMs);
+  debouncer3.interval(config.debounceMs); debouncer4.interval(config.debounceMs);
+  buildRouteDiff();
+
+  tracknumChoice = mapData[crntMap]->defaultTrack;  //--ROTARYMIN/MAX follow crntMap
+  tracknumActive = mapData[crntMap]->defaultTrack;
+  lastPos        = mapData[crntMap]->defaultTrack;
+  crntMapChoice          = crntMap;
+  trackActiveDelayChoice = trackActiveDelay;
+  alignTrack(mapData[crntMap]->defaultTrack);       //--TRACK_SETUP waits out the travel
+
+  flashDefer(FLASH_CONFIG);
+}
+
+//----------------Auto-route Functions--------------//
+
+int pickEmptyTrack()    //--best empty staging track by autoRoutePolicy, -1 if full
+{
+  const turnoutMap *yard = mapData[crntMap];
+  int best = -1;
+  for(uint16_t n = 0; n <= yard->numTracks; n++)
+  {
+    uint16_t trk = n;
+    if(autoRoutePolicy == AUTO_ROUNDROBIN)       //--scan from the track after the last pick
+    {
+      trk = (autoRouteLast + 1 + n) % (yard->numTracks + 1);
+    }
+    if(isStagingTrack(trk) == false || isOccupied(trk)) continue;
+    if(autoRoutePolicy == AUTO_ROUNDROBIN) return trk;
+    if(best < 0) { best = trk; continue; }
+    if(routeDiff[tracknumAligned][trk] < routeDiff[tracknumAligned][best]) best = trk;
+  }
+  return best;            //--NEAREST: fewest turnouts to move from the latched route
+}
+
+void preAlignChoice()   //--knob has dwelled on a track: align it ahead of the click
+{
+  if(timerPreAlign.done() == false) return;
+  if((mainSens_Report > 0) || (revSens_Report > 0)) return;  //--retry when clear
+  if(railPower == ON) return;                //--never move points under power
+  timerPreAlign.disable();
+  if(tracknumChoice != tracknumAligned) alignTrack(tracknumChoice);
+}
 
 
@@ -0,0 +1,73 @@
+//
+// Stand-in for the libFuzzer driver when there is no clang: runs the target
+// once on every file named (or every file in a directory named), or on
+// seeded random inputs with -runs=N.  Used by "make regress".
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <vector>
+#include <string>
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size );
+
+static int runFile( const std::string &path )
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL) {
+    return 0;
+  }
+  std::vector<uint8_t> data;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    data.push_back((uint8_t)c);
+  }
+  fclose(f);
+  LLVMFuzzerTestOneInput(data.data(), data.size());
+  return 1;
+}
+
+static int runPath( const std::string &path )
+{
+  DIR *dir = opendir(path.c_str());
+  if (dir == NULL) {
+    return runFile(path);
+  }
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      count += runFile(path + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+int main( int argc, char **argv )
+{
+  long runs  = 0;
+  int  files = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-runs=", 6) == 0) {
+      runs = atol(argv[i] + 6);
+    }
+    else {
+      files += runPath(argv[i]);
+    }
+  }
+  srand(1);
+  uint8_t data[512];
+  for (long r = 0; r < runs; r++) {
+    size_t size = rand() % sizeof(data);
+    for (size_t i = 0; i < size; i++) {
+      data[i] = (uint8_t)(rand() & 0x03);
+    }
+    LLVMFuzzerTestOneInput(data, size);
+  }
+  printf("fuzzReplay: %d files, %ld random inputs, no failures\n", files, runs);
+  return 0;
+}
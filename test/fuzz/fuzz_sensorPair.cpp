@@ -0,0 +1,97 @@
+//
+// libFuzzer target for the PassBy/direction decoder in lib/sensorPair.
+//
+// Each input byte is one debounced sample of the pair: bit 0 set = In beam
+// blocked, bit 1 set = Out beam blocked, the other bits are ignored.  A
+// plain model of the beams runs alongside and every sample is checked:
+//
+//   - direction and lastDirection are always 0, 1 or 2
+//   - report is exactly the beams blocked, total is 0 only when clear
+//   - total never goes down while something is on the pair (no wrap)
+//   - the direction of a train never changes until the pair clears
+//   - a PassBy comes only, and always, when one beam was blocked first,
+//     both were blocked, and the other beam cleared last
+//
+// Any failure aborts, and libFuzzer keeps the input.
+//
+
+#include "sensorPair.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+struct pairModel
+{
+  byte blocked;                            // beams blocked now
+  byte first;                              // beam blocked first since clear
+  byte seen;                               // beams blocked since clear
+  bool fresh;                              // a new train started this sample
+};
+
+#define check(ok) do { if (!(ok)) {                                    \
+    fprintf(stderr, "sensorPair: %s failed at sample %u\n", #ok, (unsigned)i); \
+    abort(); } } while (0)
+
+//---one beam edge in the model, true when it makes a PassBy
+static bool modelEdge( pairModel &m, byte beam, bool blocked )
+{
+  if (blocked) {
+    if (m.blocked == 0) {
+      m.first   = beam;
+      m.seen    = 0;
+      m.fresh   = true;
+    }
+    m.blocked |= beam;
+    m.seen    |= beam;
+    return false;
+  }
+  m.blocked &= ~beam;
+  return m.blocked == 0 && m.seen == (PAIR_IN | PAIR_OUT) && beam != m.first;
+}
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t *data, size_t size )
+{
+  sensorPair pair;
+  pairModel  m = {0, 0, 0, false};
+  byte       inLevel = HIGH, outLevel = HIGH;
+  byte       trainDirection = 0;
+
+  sensorPairInit(pair);
+  for (size_t i = 0; i < size; i++) {
+    byte nextIn  = (data[i] & PAIR_IN)  ? LOW : HIGH;
+    byte nextOut = (data[i] & PAIR_OUT) ? LOW : HIGH;
+    byte before  = pair.total;
+    bool wasBusy = pair.report != 0;
+    bool modelPassBy = false;
+    m.fresh = false;
+
+    if (nextIn != inLevel) {               // In before Out, like the decoder
+      modelPassBy |= modelEdge(m, PAIR_IN, nextIn == LOW);
+    }
+    if (nextOut != outLevel) {
+      modelPassBy |= modelEdge(m, PAIR_OUT, nextOut == LOW);
+    }
+    inLevel  = nextIn;
+    outLevel = nextOut;
+
+    bool passBy = sensorPairUpdate(pair, inLevel, outLevel);
+
+    check(pair.direction <= PAIR_OUTBOUND && pair.lastDirection <= PAIR_OUTBOUND);
+    check(pair.report == m.blocked);
+    check((pair.total == 0) == (pair.report == 0));
+    if (wasBusy && pair.report != 0 && !m.fresh) {
+      check(pair.total >= before);
+    }
+    if (pair.report == 0 || m.fresh) {     // clear, or cleared and blocked
+      trainDirection = pair.direction;     // again inside one sample
+    }
+    else if (trainDirection == 0) {
+      trainDirection = pair.direction;
+    }
+    else {
+      check(pair.direction == trainDirection);
+    }
+    check(passBy == modelPassBy);
+    check(!passBy || pair.passByState);
+  }
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+  Arduino.h - host stand-in for the ESP32 Arduino core
+
+  Just enough of the core for the staging yard firmware and its
+  libraries to build and run on Linux under [env:native]:
+
+    pins      digitalWrite/digitalRead/pinMode keep a level per pin.  A test
+              drives an input with shimSetPin(), which also runs any
+              handler from attachInterrupt() on a matching edge.
+    time      micros()/millis() read the bcsjTimer virtual clock
+              (BCSJ_VIRTUAL_CLOCK), and delay() moves it forward.  Every
+              digitalRead() costs shimReadStepUs of virtual time, so the
+              firmware's polling loops move the clock on their own.
+    shiftOut  every byte shifted out is kept, and the 16 bit word on the
+              shift register is latched into shimShiftWord on the rising
+              edge of the latch pin.  The 32 bits shifted out before it,
+              stages further down the chain, go to shimShiftFar.
+    Serial    output is kept in shimSerialOut, input comes from
+              shimSerialFeed().  availableForWrite() reports shimTxRoom,
+              so a test can play a UART whose buffer is full.
+*/
+
+
+#ifndef __ARDUINO_SHIM_H__
+#define __ARDUINO_SHIM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+#define LSBFIRST        0
+#define MSBFIRST        1
+#define DEC             10
+#define HEX             16
+#define BIN             2
+#define IRAM_ATTR
+
+#define SHIM_PINS       40
+
+#define bitRead(value, bit)   (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)    ((value) |= (1UL << (bit)))
+#define bitClear(value, bit)  ((value) &= ~(1UL << (bit)))
+
+void          pinMode( uint8_t pin, uint8_t mode );
+void          digitalWrite( uint8_t pin, uint8_t val );
+int           digitalRead( uint8_t pin );
+void          shiftOut( uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val );
+unsigned long micros( void );
+unsigned long millis( void );
+void          delay( uint32_t ms );
+void          delayMicroseconds( uint32_t us );
+void          yield( void );
+int           digitalPinToInterrupt( uint8_t pin );
+void          attachInterrupt( uint8_t pin, void (*isr)( void ), int mode );
+void          detachInterrupt( uint8_t pin );
+
+//
+// Serial
+//
+class HardwareSerial
+{
+  public:
+    void   begin( unsigned long baud ) { (void)baud; }
+    void   end( void ) {}
+    int    available( void );
+    int    read( void );
+    int    peek( void );
+    int    availableForWrite( void );
+    void   flush( void ) {}
+    size_t write( uint8_t c );
+    size_t write( const uint8_t *buf, size_t len );
+    size_t print( const char *s );
+    size_t print( char c );
+    size_t print( long n, int base = DEC );
+    size_t print( unsigned long n, int base = DEC );
+    size_t print( int n, int base = DEC )          { return print((long)n, base); }
+    size_t print( unsigned int n, int base = DEC ) { return print((unsigned long)n, base); }
+    size_t print( unsigned char n, int base = DEC ) { return print((unsigned long)n, base); }
+    size_t print( double n, int digits = 2 );
+    size_t println( void )                         { return print("\r\n"); }
+    template <class T> size_t println( T val )     { size_t n = print(val); return n + println(); }
+    template <class T> size_t println( T val, int fmt ) { size_t n = print(val, fmt); return n + println(); }
+    int    printf( const char *format, ... );
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+//
+// Test side of the shim
+//
+extern uint8_t      shimPinLevel[SHIM_PINS];     // last level written or driven
+extern uint8_t      shimPinMode[SHIM_PINS];
+extern uint32_t     shimReadStepUs;              // virtual time per digitalRead()
+extern void       (*shimReadHook)( uint8_t pin ); // called before each digitalRead()
+extern uint16_t     shimShiftWord;               // word latched into the 74HC595s
+extern uint32_t     shimShiftFar;                // latched into the stages behind them
+extern uint32_t     shimShiftLatches;            // latch rising edges seen
+extern std::string  shimSerialOut;
+extern int          shimTxRoom;                  // what availableForWrite() says
+
+void shimReset( void );                          // pins, serial, hooks
+void shimSetPin( uint8_t pin, uint8_t level );   // drive an input, fire its ISR
+void shimSerialFeed( const char *text );         // queue bytes for Serial.read()
+
+#endif
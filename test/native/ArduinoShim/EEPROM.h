@@ -0,0 +1,41 @@
+/*
+  EEPROM.h - host stand-in for the ESP32 EEPROM emulation
+
+  A plain byte array, blank (0xFF) at start.  Only here so the
+  one time migration from the old EEPROM bytes can be tested.
+*/
+
+
+#ifndef __EEPROM_SHIM_H__
+#define __EEPROM_SHIM_H__
+
+#include "Arduino.h"
+
+#define SHIM_EEPROM_SIZE  512
+
+class EEPROMClass
+{
+  public:
+            EEPROMClass()           { memset(bytes, 0xFF, sizeof(bytes)); }
+    bool    begin( size_t size )            { (void)size; return true; }
+    void    end( void )                     {}
+    bool    commit( void )                  { return true; }
+    uint8_t read( int address )             { return bytes[address % SHIM_EEPROM_SIZE]; }
+    void    write( int address, uint8_t v ) { bytes[address % SHIM_EEPROM_SIZE] = v; }
+    template <class T> T &get( int address, T &t )
+    {
+      memcpy(&t, &bytes[address], sizeof(T));
+      return t;
+    }
+    template <class T> const T &put( int address, const T &t )
+    {
+      memcpy(&bytes[address], &t, sizeof(T));
+      return t;
+    }
+
+    uint8_t bytes[SHIM_EEPROM_SIZE];
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
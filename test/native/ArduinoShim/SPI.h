@@ -0,0 +1,11 @@
+/*
+  SPI.h - host stand-in, nothing in the firmware uses SPI
+*/
+
+
+#ifndef __SPI_SHIM_H__
+#define __SPI_SHIM_H__
+
+#include "Arduino.h"
+
+#endif
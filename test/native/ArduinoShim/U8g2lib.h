@@ -0,0 +1,66 @@
+/*
+  U8g2lib.h - headless stand-in for the U8g2 display driver
+
+  Nothing is drawn.  The strings of each frame are kept instead, so a test
+  can ask what the panel shows: drawStr() adds to the frame being built,
+  sendBuffer() makes it the shown frame and counts it.  getMenuEvent()
+  hands back the 3 button board events queued with press().
+*/
+
+
+#ifndef __U8G2LIB_SHIM_H__
+#define __U8G2LIB_SHIM_H__
+
+#include "Arduino.h"
+
+#define U8X8_PIN_NONE              255
+#define U8X8_MSG_GPIO_MENU_SELECT  80
+#define U8X8_MSG_GPIO_MENU_NEXT    81
+#define U8X8_MSG_GPIO_MENU_PREV    82
+#define U8X8_MSG_GPIO_MENU_HOME    83
+
+typedef uint8_t u8g2_cb_t;
+extern const u8g2_cb_t U8G2_R0[];
+
+extern const uint8_t u8g2_font_helvB08_te[];
+extern const uint8_t u8g2_font_helvB10_te[];
+extern const uint8_t u8g2_font_helvB12_te[];
+extern const uint8_t u8g2_font_helvR08_te[];
+extern const uint8_t u8g2_font_fub35_tf[];
+
+class U8G2
+{
+  public:
+    bool     begin( void ) { return true; }
+    bool     begin( uint8_t select, uint8_t next, uint8_t prev, uint8_t up = U8X8_PIN_NONE,
+                    uint8_t down = U8X8_PIN_NONE, uint8_t home = U8X8_PIN_NONE );
+    void     clearBuffer( void )                         { building.clear(); }
+    void     sendBuffer( void );
+    void     setFont( const uint8_t *font )              { (void)font; }
+    void     setDrawColor( uint8_t color )               { (void)color; }
+    void     setPowerSave( uint8_t is_enable )           { powerSave = is_enable; }
+    uint16_t drawStr( int x, int y, const char *s );
+    void     drawHLine( int x, int y, int w )            { (void)x; (void)y; (void)w; }
+    void     drawBox( int x, int y, int w, int h )       { (void)x; (void)y; (void)w; (void)h; }
+    void     drawFrame( int x, int y, int w, int h )     { (void)x; (void)y; (void)w; (void)h; }
+    uint8_t  getMenuEvent( void );
+
+    void     press( uint8_t event )                      { menuEvent = event; }   // test side
+    bool     shows( const char *s ) const                { return shown.find(s) != std::string::npos; }
+
+    std::string building;                                // strings of the frame being drawn
+    std::string shown;                                   // strings of the last frame sent
+    uint32_t    frames    = 0;                           // sendBuffer() calls
+    uint8_t     powerSave = 0;
+    uint8_t     menuEvent = 0;
+};
+
+class U8G2_SH1106_128X64_NONAME_F_HW_I2C : public U8G2
+{
+  public:
+    U8G2_SH1106_128X64_NONAME_F_HW_I2C( const u8g2_cb_t *rotation, uint8_t reset = U8X8_PIN_NONE,
+                                        uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE )
+    { (void)rotation; (void)reset; (void)clock; (void)data; }
+};
+
+#endif
@@ -0,0 +1,20 @@
+/*
+  Wire.h - host stand-in, the display shim never touches the bus
+*/
+
+
+#ifndef __WIRE_SHIM_H__
+#define __WIRE_SHIM_H__
+
+#include "Arduino.h"
+
+class TwoWire
+{
+  public:
+    bool begin( void )                  { return true; }
+    void setClock( uint32_t frequency ) { (void)frequency; }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,262 @@
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "Wire.h"
+#include "bcsjTimer.h"
+#include <stdarg.h>
+
+HardwareSerial Serial;
+EEPROMClass    EEPROM;
+TwoWire        Wire;
+
+uint8_t      shimPinLevel[SHIM_PINS];
+uint8_t      shimPinMode[SHIM_PINS];
+uint32_t     shimReadStepUs   = 0;
+void       (*shimReadHook)( uint8_t pin ) = NULL;
+uint16_t     shimShiftWord    = 0;
+uint32_t     shimShiftFar     = 0;
+uint32_t     shimShiftLatches = 0;
+std::string  shimSerialOut;
+int          shimTxRoom       = 128;
+
+static void      (*shimIsr[SHIM_PINS])( void );
+static int         shimIsrMode[SHIM_PINS];
+static uint64_t    shimShiftReg = 0;
+static std::string shimSerialIn;
+
+
+/*---------------------------------------------------------------------------
+** RESET
+**
+** Back to power up: pins high (pulled up), no hooks.  The virtual clock
+** keeps running, timers still queued from before stay in order.
+**--------------------------------------------------------------------------*/
+void shimReset( void )
+{
+  memset(shimPinLevel, HIGH, sizeof(shimPinLevel));
+  memset(shimPinMode, INPUT, sizeof(shimPinMode));
+  memset(shimIsr, 0, sizeof(shimIsr));
+  shimReadStepUs   = 0;
+  shimReadHook     = NULL;
+  shimShiftWord    = 0;
+  shimShiftFar     = 0;
+  shimShiftLatches = 0;
+  shimShiftReg     = 0;
+  shimSerialOut.clear();
+  shimSerialIn.clear();
+  shimTxRoom = 128;
+}
+
+
+/*---------------------------------------------------------------------------
+** PINS
+**
+** The latch pin is not known here, so any rising edge on a pin that has
+** had a shiftOut() since the last latch copies the shift register out.
+**--------------------------------------------------------------------------*/
+static bool shimShiftPending = false;
+
+void pinMode( uint8_t pin, uint8_t mode )
+{
+  if (pin < SHIM_PINS) {
+    shimPinMode[pin] = mode;
+  }
+}
+
+void digitalWrite( uint8_t pin, uint8_t val )
+{
+  if (pin >= SHIM_PINS) {
+    return;
+  }
+  if (val == HIGH && shimPinLevel[pin] == LOW && shimShiftPending) {
+    shimShiftWord    = (uint16_t)shimShiftReg;
+    shimShiftFar     = (uint32_t)(shimShiftReg >> 16);
+    shimShiftPending = false;
+    shimShiftLatches++;
+  }
+  shimPinLevel[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead( uint8_t pin )
+{
+  if (shimReadHook != NULL) {
+    shimReadHook(pin);
+  }
+  bcsjClockAdvance(shimReadStepUs);
+  return pin < SHIM_PINS ? shimPinLevel[pin] : LOW;
+}
+
+void shimSetPin( uint8_t pin, uint8_t level )
+{
+  if (pin >= SHIM_PINS) {
+    return;
+  }
+  uint8_t last = shimPinLevel[pin];
+  shimPinLevel[pin] = level ? HIGH : LOW;
+  if (shimIsr[pin] == NULL || last == shimPinLevel[pin]) {
+    return;
+  }
+  if (shimIsrMode[pin] == CHANGE ||
+      (shimIsrMode[pin] == RISING  && shimPinLevel[pin] == HIGH) ||
+      (shimIsrMode[pin] == FALLING && shimPinLevel[pin] == LOW)) {
+    shimIsr[pin]();
+  }
+}
+
+void shiftOut( uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint8_t val )
+{
+  (void)dataPin; (void)clockPin;
+  for (uint8_t i = 0; i < 8; i++) {
+    uint8_t bit = bitOrder == MSBFIRST ? (val >> (7 - i)) & 1 : (val >> i) & 1;
+    shimShiftReg = (shimShiftReg << 1) | bit;
+  }
+  shimShiftPending = true;
+}
+
+int digitalPinToInterrupt( uint8_t pin )
+{
+  return pin;
+}
+
+void attachInterrupt( uint8_t pin, void (*isr)( void ), int mode )
+{
+  if (pin < SHIM_PINS) {
+    shimIsr[pin]     = isr;
+    shimIsrMode[pin] = mode;
+  }
+}
+
+void detachInterrupt( uint8_t pin )
+{
+  if (pin < SHIM_PINS) {
+    shimIsr[pin] = NULL;
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** TIME
+**
+** All of it comes from the bcsjTimer virtual clock
+**--------------------------------------------------------------------------*/
+unsigned long micros( void )
+{
+  return (unsigned long)(uint32_t)bcsjNow();
+}
+
+unsigned long millis( void )
+{
+  return (unsigned long)(uint32_t)(bcsjNow() / 1000ULL);
+}
+
+void delay( uint32_t ms )
+{
+  bcsjClockAdvance(bcsjMillis(ms));
+}
+
+void delayMicroseconds( uint32_t us )
+{
+  bcsjClockAdvance(us);
+}
+
+void yield( void )
+{
+}
+
+
+/*---------------------------------------------------------------------------
+** SERIAL
+**--------------------------------------------------------------------------*/
+void shimSerialFeed( const char *text )
+{
+  shimSerialIn += text;
+}
+
+int HardwareSerial::available( void )
+{
+  return (int)shimSerialIn.size();
+}
+
+int HardwareSerial::read( void )
+{
+  if (shimSerialIn.empty()) {
+    return -1;
+  }
+  int c = (uint8_t)shimSerialIn[0];
+  shimSerialIn.erase(0, 1);
+  return c;
+}
+
+int HardwareSerial::peek( void )
+{
+  return shimSerialIn.empty() ? -1 : (uint8_t)shimSerialIn[0];
+}
+
+int HardwareSerial::availableForWrite( void )
+{
+  return shimTxRoom;
+}
+
+size_t HardwareSerial::write( uint8_t c )
+{
+  shimSerialOut += (char)c;
+  return 1;
+}
+
+size_t HardwareSerial::write( const uint8_t *buf, size_t len )
+{
+  shimSerialOut.append((const char *)buf, len);
+  return len;
+}
+
+size_t HardwareSerial::print( const char *s )
+{
+  return write((const uint8_t *)s, strlen(s));
+}
+
+size_t HardwareSerial::print( char c )
+{
+  return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print( long n, int base )
+{
+  if (n < 0 && base == DEC) {
+    return print('-') + print((unsigned long)-n, base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t HardwareSerial::print( unsigned long n, int base )
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+  *p = 0;
+  if (base < 2) {
+    base = DEC;
+  }
+  do {
+    unsigned digit = n % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+    n /= base;
+  } while (n != 0);
+  return print(p);
+}
+
+size_t HardwareSerial::print( double n, int digits )
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+int HardwareSerial::printf( const char *format, ... )
+{
+  char buf[128];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  print(buf);
+  return len;
+}
@@ -0,0 +1,38 @@
+/*
+  nvs.h - host stand-in for the ESP-IDF NVS blob calls
+
+  Blobs live in memory, keyed by namespace and key.  Sets are staged per
+  handle and only land on nvs_commit(), like the real flash.
+  shimNvsCommits counts commits, so a test can see writes being batched.
+  With shimNvsFull set every commit fails, as on a full or worn
+  partition, and shimNvsRefused counts them.
+*/
+
+
+#ifndef __NVS_SHIM_H__
+#define __NVS_SHIM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int      esp_err_t;
+typedef uint32_t nvs_handle_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NVS_NOT_FOUND   0x1102
+
+typedef enum {NVS_READONLY, NVS_READWRITE} nvs_open_mode_t;
+
+esp_err_t nvs_open( const char *name, nvs_open_mode_t mode, nvs_handle_t *handle );
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char *key, void *out, size_t *length );
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char *key, const void *value, size_t length );
+esp_err_t nvs_commit( nvs_handle_t handle );
+void      nvs_close( nvs_handle_t handle );
+
+extern uint32_t shimNvsCommits;
+extern bool     shimNvsFull;
+extern uint32_t shimNvsRefused;
+void shimNvsErase( void );                     // blank flash
+
+#endif
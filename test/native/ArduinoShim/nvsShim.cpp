@@ -0,0 +1,80 @@
+
+#include "nvs.h"
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t> > shimBlobs;
+
+static shimBlobs                       flash;          // committed blobs
+static std::map<uint32_t, shimBlobs>    staged;         // per open handle
+static std::map<uint32_t, std::string>  handleSpace;
+static uint32_t                         nextHandle = 1;
+
+uint32_t shimNvsCommits = 0;
+bool     shimNvsFull    = false;
+uint32_t shimNvsRefused = 0;
+
+
+void shimNvsErase( void )
+{
+  flash.clear();
+  staged.clear();
+  handleSpace.clear();
+  shimNvsCommits = 0;
+  shimNvsFull    = false;
+  shimNvsRefused = 0;
+}
+
+esp_err_t nvs_open( const char *name, nvs_open_mode_t mode, nvs_handle_t *handle )
+{
+  (void)mode;
+  *handle = nextHandle++;
+  handleSpace[*handle] = name;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char *key, void *out, size_t *length )
+{
+  shimBlobs::iterator blob = flash.find(handleSpace[handle] + "/" + key);
+  if (blob == flash.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out != NULL) {
+    if (*length < blob->second.size()) {
+      return ESP_FAIL;
+    }
+    memcpy(out, blob->second.data(), blob->second.size());
+  }
+  *length = blob->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char *key, const void *value, size_t length )
+{
+  const uint8_t *bytes = (const uint8_t *)value;
+  staged[handle][handleSpace[handle] + "/" + key].assign(bytes, bytes + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+  if (shimNvsFull) {
+    staged.erase(handle);
+    shimNvsRefused++;
+    return ESP_FAIL;
+  }
+  for (shimBlobs::iterator blob = staged[handle].begin(); blob != staged[handle].end(); ++blob) {
+    flash[blob->first] = blob->second;
+  }
+  staged.erase(handle);
+  shimNvsCommits++;
+  return ESP_OK;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+  staged.erase(handle);
+  handleSpace.erase(handle);
+}
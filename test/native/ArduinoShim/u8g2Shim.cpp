@@ -0,0 +1,38 @@
+
+#include "U8g2lib.h"
+
+const u8g2_cb_t U8G2_R0[1]           = {0};
+const uint8_t u8g2_font_helvB08_te[1] = {0};
+const uint8_t u8g2_font_helvB10_te[1] = {0};
+const uint8_t u8g2_font_helvB12_te[1] = {0};
+const uint8_t u8g2_font_helvR08_te[1] = {0};
+const uint8_t u8g2_font_fub35_tf[1]   = {0};
+
+
+bool U8G2::begin( uint8_t select, uint8_t next, uint8_t prev, uint8_t up,
+                  uint8_t down, uint8_t home )
+{
+  (void)select; (void)next; (void)prev; (void)up; (void)down; (void)home;
+  return true;
+}
+
+void U8G2::sendBuffer( void )
+{
+  shown = building;
+  frames++;
+}
+
+uint16_t U8G2::drawStr( int x, int y, const char *s )
+{
+  (void)x; (void)y;
+  building += s;
+  building += '\n';
+  return (uint16_t)(strlen(s) * 6);
+}
+
+uint8_t U8G2::getMenuEvent( void )
+{
+  uint8_t event = menuEvent;
+  menuEvent = 0;
+  return event;
+}
@@ -0,0 +1,268 @@
+
+#include "traceReplay.h"
+#include "yardConfig.h"
+#include <nvs.h>
+
+void setup();
+void loop();
+
+struct replayStop {};
+
+traceReplay replay;
+
+static void replayHook( uint8_t pin )
+{
+  (void)pin;
+  replay.tick();
+}
+
+static std::vector<uint8_t> *dumpTo = NULL;
+
+static void dumpPut( uint8_t c )
+{
+  dumpTo->push_back(c);
+}
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+traceReplay::traceReplay()
+{
+  tolerance  = bcsjMillis(20);
+  readStepUs = 1000;
+  playing    = NULL;
+  next       = 0;
+  horizon    = 0;
+  bootStamp  = 0;
+  inTick     = false;
+  inRun      = false;
+}
+
+
+/*---------------------------------------------------------------------------
+** DECODE
+**--------------------------------------------------------------------------*/
+static uint32_t getLe( const uint8_t *p, uint8_t bytes )
+{
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    v |= (uint32_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+static boolean getVarint( const uint8_t *&p, const uint8_t *end, uint32_t &v )
+{
+  v = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (p >= end) {
+      return false;
+    }
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if ((b & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+boolean traceReplay::decode( const uint8_t *buf, size_t len, traceFile &out )
+{
+  const size_t head = 4 + 14;              // magic, version .. body bytes
+  size_t at = 0;
+  while (at + head <= len && memcmp(&buf[at], "BTRC", 4) != 0) {
+    at++;
+  }
+  if (at + head > len || buf[at + 4] != TRACE_VERSION) {
+    return false;
+  }
+  const uint8_t *p      = &buf[at + 4];
+  uint8_t        bootLen = p[1];
+  uint16_t       records = getLe(&p[2], 2);
+  uint32_t       body    = getLe(&p[10], 4);
+  size_t         frame   = 14 + bootLen + body;
+  if (at + 4 + frame + 2 > len ||
+      configCrc(p, frame) != getLe(&p[frame], 2)) {
+    return false;
+  }
+
+  out.lost = getLe(&p[4], 2);
+  out.span = getLe(&p[6], 4);
+  out.boot.clear();
+  out.events.clear();
+
+  const uint8_t *q   = &p[14];
+  const uint8_t *end = q + bootLen;
+  while (q < end) {
+    traceBlob blob;
+    uint8_t keyLen = *q++;
+    if (q + keyLen + 1 > end) return false;
+    blob.key.assign((const char *)q, keyLen);
+    q += keyLen;
+    uint8_t dataLen = *q++;
+    if (q + dataLen > end) return false;
+    blob.data.assign(q, q + dataLen);
+    q += dataLen;
+    out.boot.push_back(blob);
+  }
+
+  end = q + body;
+  bcsjTime64 t = 0;
+  for (uint16_t i = 0; i < records; i++) {
+    uint32_t   dt, value;
+    traceEvent e;
+    if (!getVarint(q, end, dt) || q >= end) return false;
+    uint8_t tag = *q++;
+    if (!getVarint(q, end, value)) return false;
+    t      += dt;
+    e.at    = t;
+    e.kind  = tag >> 6;
+    e.arg   = tag & 0x3F;
+    e.value = value;
+    out.events.push_back(e);
+  }
+  return q == end;
+}
+
+boolean traceReplay::decode( const std::string &log, traceFile &out )
+{
+  return decode((const uint8_t *)log.data(), log.size(), out);
+}
+
+
+/*---------------------------------------------------------------------------
+** RUN
+**
+** A trace that filled its buffer says nothing past its last record, so it
+** is only played that far.
+**--------------------------------------------------------------------------*/
+bcsjTime64 traceReplay::end( const traceFile &t )
+{
+  if (t.lost && !t.events.empty()) {
+    return t.events.back().at;
+  }
+  return t.span;
+}
+
+void traceReplay::tick( void )
+{
+  if (inTick || playing == NULL || trace.started() == bootStamp) {
+    return;                                // setup() has not begun its trace yet
+  }
+  inTick = true;
+  bcsjTime64 now = bcsjNow() - trace.started();
+  while (next < playing->events.size() && playing->events[next].at <= now) {
+    const traceEvent &e = playing->events[next++];
+    if (e.kind == TRACE_PIN && e.arg == TRACE_REMOTE) {
+      char line[16];
+      if ((e.value & 0xFF) == 0xFF) snprintf(line, sizeof(line), "%c\n", e.value >> 8);
+      else snprintf(line, sizeof(line), "%c %u\n", e.value >> 8, e.value & 0xFF);
+      shimSerialFeed(line);                // typed again, runs at the next poll
+    }
+    else if (e.kind == TRACE_PIN) {
+      shimSetPin(e.arg, e.value);
+    }
+  }
+  inTick = false;
+  if (inRun && now >= horizon) {
+    throw replayStop();
+  }
+}
+
+void traceReplay::run( const traceFile &golden, traceFile &replayed )
+{
+  shimNvsErase();
+  for (size_t i = 0; i < golden.boot.size(); i++) {
+    const traceBlob &b = golden.boot[i];
+    nvsWriteBlob(b.key.c_str(), b.data.data(), b.data.size());
+  }
+  shimReset();
+  shimReadStepUs = readStepUs;
+  shimReadHook   = replayHook;
+  playing   = &golden;
+  next      = 0;
+  horizon   = end(golden);
+  bootStamp = trace.started();
+
+  setup();
+  inRun = true;
+  try {
+    for (;;) {
+      loop();
+    }
+  }
+  catch (replayStop &) {
+  }
+  inRun        = false;
+  playing      = NULL;
+  shimReadHook = NULL;
+
+  std::vector<uint8_t> bytes;
+  dumpTo = &bytes;
+  trace.dump(dumpPut, bcsjNow());
+  dumpTo = NULL;
+  decode(bytes.data(), bytes.size(), replayed);
+}
+
+
+/*---------------------------------------------------------------------------
+** COMPARE
+**
+** Outputs in the last tolerance before the end may land either side of
+** it in the replay, so only the ones before that have to match.
+**--------------------------------------------------------------------------*/
+static void outputs( const traceFile &t, bcsjTime64 until, std::vector<traceEvent> &out )
+{
+  out.clear();
+  for (size_t i = 0; i < t.events.size(); i++) {
+    if (t.events[i].kind != TRACE_PIN && t.events[i].at <= until) {
+      out.push_back(t.events[i]);
+    }
+  }
+}
+
+boolean traceReplay::compare( const traceFile &want, const traceFile &got, traceDiff &diff )
+{
+  static const char *const kinds[] = {"pin", "route", "power", "mode"};
+  bcsjTime64 until = end(want) > tolerance ? end(want) - tolerance : 0;
+  std::vector<traceEvent> w, g;
+  outputs(want, until, w);
+  outputs(got, until + tolerance, g);
+  memset(&diff, 0, sizeof(diff));
+
+  for (size_t i = 0; i < w.size(); i++) {
+    diff.index = i;
+    diff.want  = w[i];
+    if (i >= g.size()) {
+      snprintf(diff.why, sizeof(diff.why), "%s %u at %llu us never came",
+               kinds[w[i].kind], w[i].value, (unsigned long long)w[i].at);
+      return false;
+    }
+    diff.got = g[i];
+    if (g[i].kind != w[i].kind || g[i].value != w[i].value) {
+      snprintf(diff.why, sizeof(diff.why), "%s %u at %llu us, replay gave %s %u",
+               kinds[w[i].kind], w[i].value, (unsigned long long)w[i].at,
+               kinds[g[i].kind], g[i].value);
+      return false;
+    }
+    bcsjTime64 off = g[i].at > w[i].at ? g[i].at - w[i].at : w[i].at - g[i].at;
+    if (off > tolerance) {
+      snprintf(diff.why, sizeof(diff.why), "%s %u at %llu us, replay at %llu us",
+               kinds[w[i].kind], w[i].value, (unsigned long long)w[i].at,
+               (unsigned long long)g[i].at);
+      return false;
+    }
+  }
+  for (size_t i = w.size(); i < g.size(); i++) {
+    if (g[i].at + tolerance <= until) {
+      diff.index = i;
+      diff.got   = g[i];
+      snprintf(diff.why, sizeof(diff.why), "replay gave %s %u at %llu us, not in the trace",
+               kinds[g[i].kind], g[i].value, (unsigned long long)g[i].at);
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,89 @@
+/*
+  traceReplay.h - play a recorded input trace back into the firmware
+
+  decode() picks the first inputTrace frame out of a byte buffer, a serial
+  log with text around the frame is fine.  run() boots the firmware from
+  the NVS blobs the trace was recorded with, plays its TRACE_PIN edges
+  into the shim pins at their recorded times, types its serial commands
+  in again at theirs, and takes back the trace the firmware makes of
+  itself on the way.  compare() then holds the
+  outputs of the two traces side by side: the same route words, power
+  changes and mode changes in the same order, each within tolerance of
+  its recorded time.
+
+  Input edges are recorded when the firmware polls them, so a replayed
+  edge is seen at the first poll after its time, never before.  A trace
+  whose buffer filled up is played up to its last record.
+*/
+
+
+#ifndef __TRACEREPLAY_H__
+#define __TRACEREPLAY_H__
+
+#include "Arduino.h"
+#include "bcsjTimer.h"
+#include "inputTrace.h"
+#include <vector>
+
+struct traceEvent
+{
+  bcsjTime64 at;                           // us since begin()
+  uint8_t    kind;                         // traceKind
+  uint8_t    arg;
+  uint16_t   value;
+};
+
+struct traceBlob
+{
+  std::string          key;
+  std::vector<uint8_t> data;
+};
+
+struct traceFile
+{
+  uint16_t                lost;
+  bcsjTime64              span;
+  std::vector<traceBlob>  boot;
+  std::vector<traceEvent> events;
+};
+
+struct traceDiff
+{
+  size_t     index;                        // output record that differs
+  traceEvent want;
+  traceEvent got;
+  char       why[96];
+};
+
+class traceReplay
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+               traceReplay();              // constructor
+    boolean    decode( const uint8_t *buf, size_t len, traceFile &out );
+    boolean    decode( const std::string &log, traceFile &out );
+    void       run( const traceFile &golden, traceFile &replayed ); // boot, play, take back
+    boolean    compare( const traceFile &want, const traceFile &got, traceDiff &diff );
+    void       tick( void );               // play due edges, from the read hook
+
+    bcsjTime64 tolerance;                  // output time may differ by this much
+    uint32_t   readStepUs;                 // virtual time per digitalRead()
+
+  private:
+    const traceFile *playing;
+    size_t     next;
+    bcsjTime64 horizon;                    // stop the replay here
+    bcsjTime64 bootStamp;                  // trace.started() before setup()
+    boolean    inTick;
+    boolean    inRun;
+
+    bcsjTime64 end( const traceFile &t );
+
+};
+
+extern traceReplay replay;
+
+#endif
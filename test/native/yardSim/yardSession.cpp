@@ -0,0 +1,76 @@
+#include "yardSession.h"
+#include <U8g2lib.h>
+#include <nvs.h>
+
+void setup();
+extern U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2;
+
+std::string answer;
+
+
+/*---------------------------------------------------------------------------
+** PREDICATES
+**--------------------------------------------------------------------------*/
+bool standingBy( void )  { return u8g2.shows("Rotate"); }
+bool poweredUp( void )   { return sim.powered(); }
+bool poweredDown( void ) { return !sim.powered(); }
+
+
+/*---------------------------------------------------------------------------
+** BOOT
+**
+** Returns true once the firmware stands by, false if the record would not
+** save or STAND_BY did not come up within 30 s
+**--------------------------------------------------------------------------*/
+boolean sessionBoot( yardConfig &cfg )
+{
+  shimNvsErase();
+  if (!configSave(cfg)) {
+    return false;
+  }
+  shimReset();
+  sim.begin();
+  setup();
+  sim.run(standingBy, bcsjSeconds(30));
+  return standingBy();
+}
+
+boolean bootParkersburg( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.crntMap      = 1;
+  cfg.yardDelay[1] = 1;
+  return sessionBoot(cfg);
+}
+
+
+/*---------------------------------------------------------------------------
+** SERIAL LINE
+**
+** The first text line in the output: replies sit between telemetry frames
+**--------------------------------------------------------------------------*/
+bool replied( void )
+{
+  size_t start = 0;
+  while (start < shimSerialOut.size()) {
+    size_t end = shimSerialOut.find('\0', start);
+    if (end == std::string::npos) end = shimSerialOut.size();
+    size_t eol = shimSerialOut.find("\r\n", start);
+    if (eol != std::string::npos && eol < end && isupper((uint8_t)shimSerialOut[start])) {
+      answer = shimSerialOut.substr(start, eol - start);
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
+}
+
+std::string ask( const char *line )
+{
+  answer.clear();
+  shimSerialOut.clear();
+  shimSerialFeed(line);
+  sim.run(replied, bcsjSeconds(2));
+  return answer;
+}
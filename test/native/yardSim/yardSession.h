@@ -0,0 +1,30 @@
+/*
+  yardSession.h - the fixture the simulator suites share
+
+  Boots the whole firmware on the simulator with a given yardConfig and
+  runs it to STAND_BY, and talks to it over the serial line the way
+  tools/yardCtl.py does.  The predicates are for sim.run().
+*/
+
+
+#ifndef __YARDSESSION_H__
+#define __YARDSESSION_H__
+
+#include "Arduino.h"
+#include "yardConfig.h"
+#include "yardSim.h"
+#include <string>
+
+bool        standingBy( void );            // the panel shows the STAND_BY screen
+bool        poweredUp( void );
+bool        poweredDown( void );
+
+boolean     sessionBoot( yardConfig &cfg );  // blank NVS, cfg saved, boot, STAND_BY
+boolean     bootParkersburg( void );         // Parkersburg, 1 minute window
+
+bool        replied( void );               // a text line came back, now in answer
+std::string ask( const char *line );       // send one command, its reply
+
+extern std::string answer;
+
+#endif
@@ -0,0 +1,256 @@
+
+#include "yardSim.h"
+#include <algorithm>
+
+//
+// Firmware pins, as in src/main.cpp
+//
+#define SIM_POWER_PIN     2
+#define SIM_SWITCH_PIN    4
+#define SIM_ENC_A_PIN     17
+#define SIM_ENC_B_PIN     16
+#define SIM_MAIN_IN_PIN   26
+#define SIM_MAIN_OUT_PIN  27
+#define SIM_REV_IN_PIN    14
+#define SIM_REV_OUT_PIN   12
+
+#define SIM_QUAD_STEP     bcsjMillis(25)   // slow enough to stay clear of acceleration
+#define SIM_CLICK_HOLD    bcsjMillis(120)
+
+struct simStop {};
+
+static bool edgeLater( const yardSim::simEdge &a, const yardSim::simEdge &b )
+{
+  return a.at > b.at;                      // earliest edge on top of the heap
+}
+
+yardSim sim;
+
+static void simHook( uint8_t pin )
+{
+  (void)pin;
+  sim.tick();
+}
+
+
+/*---------------------------------------------------------------------------
+** CONSTRUCTOR
+**--------------------------------------------------------------------------*/
+yardSim::yardSim()
+{
+  beamGapMm   = 50;
+  passbyLimit = bcsjMillis(500);
+  stopWhen    = NULL;
+  inTick      = false;
+  inRun       = false;
+}
+
+
+/*---------------------------------------------------------------------------
+** BEGIN
+**
+** Takes over the shim read hook.  Call after shimReset(), before setup().
+**--------------------------------------------------------------------------*/
+void yardSim::begin( uint32_t readStepUs )
+{
+  queue.clear();
+  memset(&stats, 0, sizeof(stats));
+  powerOnAt  = 0;
+  powerOffAt = 0;
+  lastClear  = 0;
+  powerLevel = shimPinLevel[SIM_POWER_PIN];
+  latches    = shimShiftLatches;
+  shimReadStepUs = readStepUs;
+  shimReadHook   = simHook;
+}
+
+
+/*---------------------------------------------------------------------------
+** QUEUE
+**--------------------------------------------------------------------------*/
+void yardSim::push( bcsjTime64 at, uint8_t pin, uint8_t level, uint8_t head )
+{
+  simEdge edge = {at, pin, level, head};
+  queue.push_back(edge);
+  std::push_heap(queue.begin(), queue.end(), edgeLater);
+}
+
+boolean yardSim::idle( void )
+{
+  return queue.empty();
+}
+
+
+/*---------------------------------------------------------------------------
+** OPERATOR
+**
+** One detent is a full quadrature cycle; + runs A ahead of B
+**--------------------------------------------------------------------------*/
+void yardSim::turn( int detents, bcsjTime64 delay )
+{
+  bcsjTime64 at   = bcsjNow() + delay;
+  uint8_t    lead = detents > 0 ? SIM_ENC_B_PIN : SIM_ENC_A_PIN;
+  uint8_t    lag  = detents > 0 ? SIM_ENC_A_PIN : SIM_ENC_B_PIN;
+  for (int i = 0; i < abs(detents); i++) {
+    push(at,                    lead, LOW);
+    push(at + SIM_QUAD_STEP,     lag,  LOW);
+    push(at + SIM_QUAD_STEP * 2, lead, HIGH);
+    push(at + SIM_QUAD_STEP * 3, lag,  HIGH);
+    at += SIM_QUAD_STEP * 4;
+  }
+}
+
+void yardSim::click( bcsjTime64 delay )
+{
+  bcsjTime64 at = bcsjNow() + delay;
+  push(at, SIM_SWITCH_PIN, LOW);
+  push(at + SIM_CLICK_HOLD, SIM_SWITCH_PIN, HIGH);
+  stats.moves++;
+}
+
+void yardSim::press( bcsjTime64 hold, bcsjTime64 delay )
+{
+  bcsjTime64 at = bcsjNow() + delay;
+  push(at, SIM_SWITCH_PIN, LOW);
+  push(at + hold, SIM_SWITCH_PIN, HIGH);
+}
+
+
+/*---------------------------------------------------------------------------
+** TRAIN
+**
+** The first beam the train meets sits at 0 along its path, the second at
+** beamGapMm.  Car k blocks a beam from when its front reaches it until its
+** rear passes, so a daylight gap between cars shows up as a short unblock.
+**--------------------------------------------------------------------------*/
+void yardSim::beam( const simTrain &t, uint8_t pin, bcsjTime64 head, uint32_t offsetMm )
+{
+  if (t.gapMm == 0 && t.cars > 1) {        // close coupled: one long block, no
+    simTrain solid = t;                    // unblock/block pair at the same time
+    solid.carMm = t.carMm * t.cars;
+    solid.cars  = 1;
+    beam(solid, pin, head, offsetMm);
+    return;
+  }
+  uint32_t pitch = t.carMm + t.gapMm;
+  for (uint8_t car = 0; car < t.cars; car++) {
+    bcsjTime64 front = (bcsjTime64)(offsetMm + car * pitch) * 1000000ULL / t.speedMmS;
+    bcsjTime64 rear  = (bcsjTime64)(offsetMm + car * pitch + t.carMm) * 1000000ULL / t.speedMmS;
+    push(head + front, pin, LOW, (car == 0 && offsetMm == 0));
+    push(head + rear,  pin, HIGH);
+  }
+}
+
+bcsjTime64 yardSim::train( const simTrain &t, bcsjTime64 delay )
+{
+  uint8_t inPin  = t.sensor == SIM_MAIN ? SIM_MAIN_IN_PIN  : SIM_REV_IN_PIN;
+  uint8_t outPin = t.sensor == SIM_MAIN ? SIM_MAIN_OUT_PIN : SIM_REV_OUT_PIN;
+  uint8_t first  = t.direction == SIM_INBOUND ? inPin  : outPin;
+  uint8_t second = t.direction == SIM_INBOUND ? outPin : inPin;
+  bcsjTime64 head = bcsjNow() + delay;
+
+  beam(t, first,  head, 0);
+  beam(t, second, head, beamGapMm);
+  stats.trains++;
+  uint32_t length = t.cars * (t.carMm + t.gapMm) - t.gapMm + beamGapMm;
+  return head + (bcsjTime64)length * 1000000ULL / t.speedMmS;
+}
+
+
+/*---------------------------------------------------------------------------
+** TICK
+**
+** Runs before every firmware pin read: plays the edges that are due and
+** notes what the firmware has done with the relay and the shift register.
+**--------------------------------------------------------------------------*/
+void yardSim::tick( void )
+{
+  if (inTick) {
+    return;                                // the switch ISR reads its pin
+  }
+  inTick = true;
+  bcsjTime64 now = bcsjNow();
+  while (!queue.empty() && queue.front().at <= now) {
+    simEdge edge = queue.front();
+    std::pop_heap(queue.begin(), queue.end(), edgeLater);
+    queue.pop_back();
+    if (edge.trainHead && !powered()) {
+      stats.darkRuns++;
+    }
+    shimSetPin(edge.pin, edge.level);
+    if (edge.level == HIGH && edge.pin != SIM_SWITCH_PIN &&
+        edge.pin != SIM_ENC_A_PIN && edge.pin != SIM_ENC_B_PIN) {
+      lastClear = now;
+    }
+  }
+
+  if (shimPinLevel[SIM_POWER_PIN] != powerLevel) {
+    powerLevel = shimPinLevel[SIM_POWER_PIN];
+    if (powerLevel == HIGH) {
+      powerOnAt = now;
+    }
+    else {
+      powerOffAt = now;
+      stats.windows++;
+      if (lastClear && now - lastClear <= passbyLimit) {
+        stats.passbyEnds++;
+      }
+      else {
+        stats.timeouts++;
+      }
+      if (now - powerOnAt > stats.longestWindow) {
+        stats.longestWindow = now - powerOnAt;
+      }
+      lastClear = 0;
+    }
+  }
+  if (shimShiftLatches != latches) {
+    stats.routes += shimShiftLatches - latches;
+    latches = shimShiftLatches;
+  }
+  inTick = false;
+
+  if (inRun && (now >= stopAt || (stopWhen != NULL && stopWhen()))) {
+    throw simStop();
+  }
+}
+
+
+/*---------------------------------------------------------------------------
+** RUN
+**
+** STAND_BY never hands back to loop() by itself, so the run is ended from
+** inside tick() by throwing past the firmware.  Stop only where the state
+** can be entered again from the top: STAND_BY, or after a window closed.
+**--------------------------------------------------------------------------*/
+void loop();
+
+void yardSim::run( bool (*done)( void ), bcsjTime64 limit )
+{
+  stopWhen = done;
+  stopAt   = bcsjNow() + limit;
+  inRun    = true;
+  try {
+    for (;;) {
+      loop();
+    }
+  }
+  catch (simStop &) {
+  }
+  inRun    = false;
+  stopWhen = NULL;
+}
+
+
+/*---------------------------------------------------------------------------
+** OUTPUTS
+**--------------------------------------------------------------------------*/
+boolean yardSim::powered( void )
+{
+  return shimPinLevel[SIM_POWER_PIN] == HIGH;
+}
+
+uint16_t yardSim::route( void )
+{
+  return shimShiftWord;
+}
@@ -0,0 +1,103 @@
+/*
+  yardSim.h - discrete event model of the yard lead, for host runs
+
+  Trains are cut into cars and run over the mainSens or revSens beam pair
+  at a set speed.  Every beam edge they cause is worked out up front and
+  queued by time, together with the operator's knob turns and clicks.
+  The queue is played into the shim pins from the digitalRead() hook, so
+  the firmware sees the edges at the right virtual time however its loops
+  are nested.  Each pin read costs readStepUs of virtual time, which is
+  what moves the clock; a session of hundreds of moves runs in seconds.
+
+  While it plays the queue the sim watches the firmware's outputs: track
+  power windows, the route latched into the shift register, and trains
+  that crossed a sensor with track power off.
+*/
+
+
+#ifndef __YARDSIM_H__
+#define __YARDSIM_H__
+
+#include "Arduino.h"
+#include "bcsjTimer.h"
+#include <vector>
+
+#define SIM_MAIN       0
+#define SIM_REV        1
+#define SIM_INBOUND    1                   // same numbers as mainDirection
+#define SIM_OUTBOUND   2
+
+struct simTrain
+{
+  uint8_t  sensor;                         // SIM_MAIN or SIM_REV
+  uint8_t  direction;                      // SIM_INBOUND or SIM_OUTBOUND
+  uint8_t  cars;
+  uint16_t carMm;                          // car body, coupler face to face
+  uint16_t gapMm;                          // daylight between cars, 0 = solid
+  uint16_t speedMmS;
+};
+
+struct simStats
+{
+  uint32_t   moves;                        // clicks played
+  uint32_t   trains;                       // trains run over a beam pair
+  uint32_t   windows;                      // track power on..off spans
+  uint32_t   passbyEnds;                   // windows ended just after a train cleared
+  uint32_t   timeouts;                     // windows that ran their full time
+  uint32_t   darkRuns;                     // trains that met a beam with power off
+  uint32_t   routes;                       // words latched into the shift register
+  bcsjTime64 longestWindow;
+};
+
+class yardSim
+{
+
+  //
+  // PUBLIC function definitons
+  //
+  public:
+               yardSim();                  // constructor
+    void       begin( uint32_t readStepUs = 1000 ); // take the read hook, empty the queue
+    void       turn( int detents, bcsjTime64 delay );  // knob, + counts getPosition() up
+    void       click( bcsjTime64 delay );
+    void       press( bcsjTime64 hold, bcsjTime64 delay );  // held down, 6 s opens the menu
+    bcsjTime64 train( const simTrain &t, bcsjTime64 delay ); // returns when it clears
+    void       run( bool (*done)( void ), bcsjTime64 limit ); // loop() until done or limit
+    void       tick( void );               // play due edges, watch the outputs
+    boolean    powered( void );            // track power relay on?
+    boolean    idle( void );               // nothing left in the queue?
+    uint16_t   route( void );              // word on the shift register
+
+    simStats   stats;
+    uint16_t   beamGapMm;                  // in beam to out beam
+    bcsjTime64 passbyLimit;                // power drop this soon after a clear is a PassBy
+    bcsjTime64 powerOnAt;
+    bcsjTime64 powerOffAt;
+
+
+    struct simEdge
+    {
+      bcsjTime64 at;
+      uint8_t    pin;
+      uint8_t    level;
+      uint8_t    trainHead;                // first edge of a train, check power
+    };
+
+  private:
+    std::vector<simEdge> queue;            // min-heap on at
+    bcsjTime64 lastClear;                  // a train's tail left its last beam
+    bcsjTime64 stopAt;
+    bool     (*stopWhen)( void );
+    uint8_t    powerLevel;
+    uint32_t   latches;
+    boolean    inTick;
+    boolean    inRun;
+
+    void       push( bcsjTime64 at, uint8_t pin, uint8_t level, uint8_t head = 0 );
+    void       beam( const simTrain &t, uint8_t pin, bcsjTime64 head, uint32_t offsetMm );
+
+};
+
+extern yardSim sim;
+
+#endif
@@ -0,0 +1,84 @@
+//
+// Gestures out of lib/buttonQueue, and what a bounce burst longer than the
+// edge ring leaves behind.  Edges are stamped by hand, update() is called
+// late as when the panel loop was busy.
+// pio test -e native -f test_button
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "buttonQueue.h"
+
+static buttonQueue *btn = NULL;
+
+//---count edges 1 ms apart, the first one at level first; returns the
+//   time of the last
+static bcsjTime64 burst( bcsjTime64 at, boolean first, int count )
+{
+  boolean level = first;
+  for (int i = 0; i < count; i++) {
+    btn->edge(level, at + bcsjMillis(i));
+    level = !level;
+  }
+  return at + bcsjMillis(count - 1);
+}
+
+
+void setUp( void )
+{
+  delete btn;
+  btn = new buttonQueue();
+}
+
+void tearDown( void )
+{
+}
+
+//---a clean press and release is one click once the window is over
+void test_click( void )
+{
+  btn->edge(true,  bcsjMillis(0));
+  btn->edge(false, bcsjMillis(150));
+  btn->update(bcsjMillis(300));
+  TEST_ASSERT_EQUAL(BTN_NONE, btn->next());
+  btn->update(bcsjMillis(700));
+  TEST_ASSERT_EQUAL(BTN_CLICK, btn->next());
+  TEST_ASSERT_EQUAL(BTN_NONE, btn->next());
+  TEST_ASSERT_EQUAL(0, btn->dropped());
+}
+
+//---more bounces than the ring holds, ending released: the last level
+//   is kept, so no phantom hold and no long press after it
+void test_overflow_keeps_release( void )
+{
+  bcsjTime64 end = burst(bcsjMillis(10), true, 2 * BTN_EDGE_SLOTS + 8);
+  btn->update(end + bcsjMillis(5));
+  TEST_ASSERT_GREATER_THAN(0, btn->dropped());
+  btn->update(end + bcsjSeconds(2));
+  TEST_ASSERT_FALSE(btn->pressed());
+  TEST_ASSERT_EQUAL(BTN_NONE, btn->next());
+}
+
+//---a held press with a noisy release that overflows is still a click
+void test_overflow_bouncy_click( void )
+{
+  bcsjTime64 end = burst(bcsjMillis(10), true, BTN_EDGE_SLOTS - 1);
+  btn->update(end + bcsjMillis(100));
+  TEST_ASSERT_TRUE(btn->pressed());
+  end = burst(end + bcsjMillis(200), false, 2 * BTN_EDGE_SLOTS + 1);
+  btn->update(end + bcsjMillis(100));
+  TEST_ASSERT_FALSE(btn->pressed());
+  btn->update(end + bcsjSeconds(2));
+  TEST_ASSERT_EQUAL(BTN_CLICK, btn->next());
+  TEST_ASSERT_EQUAL(BTN_NONE, btn->next());
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_click);
+  RUN_TEST(test_overflow_keeps_release);
+  RUN_TEST(test_overflow_bouncy_click);
+  return UNITY_END();
+}
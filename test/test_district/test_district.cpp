@@ -0,0 +1,138 @@
+//
+// Power districts (POWER_DISTRICTS): only the aligned track's feed is on
+// while the window runs, the turnout word stays where it was on the chain,
+// and a click on another track starts that move once the window's train
+// is off the ladder, without waiting the window out.  Built with the flag
+// by its own env.
+// pio test -e native_districts
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+#include "yardSession.h"
+
+static uint32_t districts( void ) { return shimShiftFar & 0xFFFFFF; }  // DISTRICT_BYTES
+static bool track2Live( void )    { return districts() == (1UL << 2); }
+
+//---Parkersburg, 1 minute window, standing by on track 1
+void setUp( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+}
+
+void tearDown( void )
+{
+}
+
+//---the window feeds the aligned track alone; the turnouts see the same
+//   word as without the district stage
+void test_only_aligned_track_live( void )
+{
+  TEST_ASSERT_EQUAL(0, districts());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 4\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_HEX32(1UL << 4, districts());
+  TEST_ASSERT_EQUAL_HEX16(0x0003, sim.route());   // P4
+  sim.run(poweredDown, bcsjMinutes(3));
+  TEST_ASSERT_EQUAL_HEX32(0, districts());
+  TEST_ASSERT_EQUAL_HEX16(0x0003, sim.route());
+}
+
+//---knob from P4 down to P2 and a click, at when; a serial line would
+//   stop the run and restart the window
+static void turnToTrack2( bcsjTime64 when )
+{
+  sim.turn(-1, when);
+  sim.turn(-1, when + bcsjMillis(200));
+  sim.click(when + bcsjMillis(600));
+}
+
+//---a click on another track once the window's train is in: the window
+//   ends ladderClearSec after its PassBy, track 2 is aligned and fed long
+//   before the minute is up
+void test_back_to_back( void )
+{
+  simTrain in = {SIM_MAIN, SIM_INBOUND, 6, 200, 0, 300};
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 4\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  bcsjTime64 firstOn = sim.powerOnAt;
+  bcsjTime64 clears  = sim.train(in, bcsjSeconds(1));
+  turnToTrack2(clears - bcsjNow() + bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(2));
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjSeconds(15), sim.powerOffAt - clears);
+  TEST_ASSERT_EQUAL_HEX32(0, districts());        // points move with every track dead
+
+  sim.run(track2Live, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(sim.powered());
+  TEST_ASSERT_EQUAL_HEX32(1UL << 2, districts());
+  TEST_ASSERT_EQUAL_HEX16(0x0010, sim.route());   // P2
+  TEST_ASSERT_LESS_THAN(bcsjSeconds(40), sim.powerOnAt - firstOn);
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(standingBy, bcsjSeconds(5));
+  TEST_ASSERT_EQUAL_HEX32(0, districts());
+}
+
+//---no train seen this window: clear sensors do not say the ladder is
+//   empty, the next move waits for the window to run out
+void test_no_train_waits( void )
+{
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 4\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  bcsjTime64 firstOn = sim.powerOnAt;
+  turnToTrack2(bcsjSeconds(5));
+  sim.run(poweredDown, bcsjMinutes(3));
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjMinutes(1), sim.powerOffAt - firstOn);
+  TEST_ASSERT_EQUAL_HEX16(0x0003, sim.route());   // still P4 at the cut
+  sim.run(track2Live, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_HEX16(0x0010, sim.route());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---a click on the same track is still one more window after this one
+void test_same_track_extends( void )
+{
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 5\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("E\n").c_str());
+  sim.run(NULL, bcsjSeconds(20));
+  TEST_ASSERT_TRUE(sim.powered());
+  TEST_ASSERT_EQUAL_HEX32(1UL << 5, districts());
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(poweredUp, bcsjSeconds(5));
+  TEST_ASSERT_EQUAL_HEX32(1UL << 5, districts());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---the next move waits while a train is still on the yard lead
+void test_waits_for_clear_lead( void )
+{
+  simTrain out = {SIM_MAIN, SIM_OUTBOUND, 6, 200, 0, 300};
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 4\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  bcsjTime64 clears = sim.train(out, bcsjSeconds(1));
+  sim.run(NULL, bcsjSeconds(2));                  // head on the beams
+  TEST_ASSERT_EQUAL(0, ask("I\n").find("SENS main 11"));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("S 2\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A\n").c_str());
+  sim.run(poweredDown, bcsjMinutes(1));
+  TEST_ASSERT_GREATER_OR_EQUAL(clears, sim.powerOffAt);
+  sim.run(track2Live, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_HEX32(1UL << 2, districts());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_only_aligned_track_live);
+  RUN_TEST(test_back_to_back);
+  RUN_TEST(test_no_train_waits);
+  RUN_TEST(test_same_track_extends);
+  RUN_TEST(test_waits_for_clear_lead);
+  return UNITY_END();
+}
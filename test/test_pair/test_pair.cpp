@@ -0,0 +1,93 @@
+//
+// PassBy and direction decoding in lib/sensorPair.  The fuzz target in
+// test/fuzz checks the same rules on random samples.
+// pio test -e native -f test_pair
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "sensorPair.h"
+
+static sensorPair pair;
+
+//---feed samples: bit 0 In blocked, bit 1 Out blocked; count the PassBys
+static int play( const byte *samples, int count )
+{
+  int passBys = 0;
+  for (int i = 0; i < count; i++) {
+    byte in  = (samples[i] & PAIR_IN)  ? LOW : HIGH;
+    byte out = (samples[i] & PAIR_OUT) ? LOW : HIGH;
+    if (sensorPairUpdate(pair, in, out)) passBys++;
+  }
+  return passBys;
+}
+
+
+void setUp( void )
+{
+  sensorPairInit(pair);
+}
+
+void tearDown( void )
+{
+}
+
+void test_outbound_passby( void )
+{
+  const byte samples[] = {2, 3, 1, 0};
+  TEST_ASSERT_EQUAL(0, play(samples, 1));
+  TEST_ASSERT_EQUAL(PAIR_OUTBOUND, pair.direction);
+  TEST_ASSERT_EQUAL(1, play(samples + 1, 3));
+  TEST_ASSERT_EQUAL(PAIR_OUTBOUND, pair.lastDirection);
+  TEST_ASSERT_EQUAL(0, pair.direction);
+  TEST_ASSERT_TRUE(pair.passByState);
+}
+
+void test_inbound_passby( void )
+{
+  const byte samples[] = {1, 3, 2, 0};
+  TEST_ASSERT_EQUAL(1, play(samples, 4));
+  TEST_ASSERT_EQUAL(PAIR_INBOUND, pair.lastDirection);
+}
+
+//---in over the Out beam, then back out over it: not a PassBy
+void test_backing_out( void )
+{
+  const byte samples[] = {2, 3, 2, 0};
+  TEST_ASSERT_EQUAL(0, play(samples, 4));
+  TEST_ASSERT_FALSE(pair.passByState);
+}
+
+//---a chattering beam under a standing train: total stops at the top and
+//   the direction holds
+void test_chatter_saturates( void )
+{
+  const byte enter[] = {2};
+  const byte chatter[] = {3, 2};
+  const byte leave[] = {3, 1, 0};
+  play(enter, 1);
+  for (int i = 0; i < 200; i++) {
+    play(chatter, 2);
+    TEST_ASSERT_EQUAL(PAIR_OUTBOUND, pair.direction);
+  }
+  TEST_ASSERT_EQUAL(PAIR_TOTAL_MAX, pair.total);
+  TEST_ASSERT_EQUAL(1, play(leave, 3));
+}
+
+//---one beam at a time never counts
+void test_short_car( void )
+{
+  const byte samples[] = {2, 0, 1, 0};
+  TEST_ASSERT_EQUAL(0, play(samples, 4));
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_outbound_passby);
+  RUN_TEST(test_inbound_passby);
+  RUN_TEST(test_backing_out);
+  RUN_TEST(test_chatter_saturates);
+  RUN_TEST(test_short_car);
+  return UNITY_END();
+}
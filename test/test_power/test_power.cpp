@@ -0,0 +1,146 @@
+//
+// Track power stage in lib/trackPower: the soft-start ramp, the overcurrent
+// trip and how fast it comes, and what clears it.  Readings are fed by hand
+// at the sampling timer's period.
+// pio test -e native -f test_power
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "trackPower.h"
+
+#define MV_NORMAL  250                     // 0.5 A
+#define MV_SHORT   2500                    // 5 A
+
+static trackPowerStage stage;
+static int tripCalls;
+
+static void countTrip( void ) { tripCalls++; }
+
+//---readings every POWER_SAMPLE_US for span, returns the time at the last
+static bcsjTime64 feed( uint16_t mv, bcsjTime64 span )
+{
+  bcsjTime64 end = bcsjNow() + span;
+  while (bcsjNow() < end) {
+    bcsjClockAdvance(POWER_SAMPLE_US);
+    stage.sample(mv, bcsjNow());
+  }
+  return bcsjNow();
+}
+
+
+void setUp( void )
+{
+  bcsjClockSet(bcsjSeconds(10));
+  stage.begin(2, 34);
+  stage.onTrip = countTrip;
+  tripCalls    = 0;
+}
+
+void tearDown( void )
+{
+}
+
+//---duty climbs from off to full over the ramp and not before its end
+void test_soft_start( void )
+{
+  stage.set(HIGH);
+  TEST_ASSERT_EQUAL(0, stage.duty());
+  uint8_t last = 0;
+  while (bcsjNow() < bcsjSeconds(10) + bcsjMillis(POWER_RAMP_MS) - POWER_SAMPLE_US) {
+    feed(MV_NORMAL, POWER_SAMPLE_US);
+    TEST_ASSERT_GREATER_OR_EQUAL(last, stage.duty());
+    TEST_ASSERT_LESS_THAN(POWER_DUTY_FULL, stage.duty());
+    last = stage.duty();
+  }
+  TEST_ASSERT_GREATER_THAN(POWER_DUTY_FULL / 2, last);
+  feed(MV_NORMAL, bcsjMillis(1));
+  TEST_ASSERT_EQUAL(POWER_DUTY_FULL, stage.duty());
+  TEST_ASSERT_EQUAL(TRIP_NONE, stage.tripped());
+}
+
+//---a short that starts just after a reading is off within 1 ms
+void test_trip_under_1ms( void )
+{
+  stage.set(HIGH);
+  feed(MV_NORMAL, bcsjMillis(POWER_RAMP_MS + 10));
+  TEST_ASSERT_EQUAL(POWER_DUTY_FULL, stage.duty());
+
+  bcsjTime64 shortAt = bcsjNow() + 1;
+  bcsjTime64 offAt   = 0;
+  while (offAt == 0 && bcsjNow() < shortAt + bcsjMillis(5)) {
+    feed(MV_SHORT, POWER_SAMPLE_US);
+    if (stage.duty() == 0) offAt = bcsjNow();
+  }
+  TEST_ASSERT_NOT_EQUAL(0, offAt);
+  TEST_ASSERT_LESS_THAN(bcsjMillis(1), offAt - shortAt);
+  TEST_ASSERT_EQUAL(TRIP_OVERCURRENT, stage.tripped());
+  TEST_ASSERT_EQUAL(5000, stage.tripMa());
+  TEST_ASSERT_EQUAL((POWER_CONFIRM - 1) * POWER_SAMPLE_US, stage.tripUs());
+  TEST_ASSERT_EQUAL(1, tripCalls);
+  TEST_ASSERT_EQUAL(HIGH, stage.level());  // the firmware has not answered yet
+}
+
+//---one reading over the limit is noise, the trip needs POWER_CONFIRM
+void test_single_spike( void )
+{
+  stage.set(HIGH);
+  feed(MV_NORMAL, bcsjMillis(POWER_RAMP_MS + 10));
+  for (int i = 0; i < 10; i++) {
+    feed(MV_SHORT, POWER_SAMPLE_US * (POWER_CONFIRM - 1));
+    feed(MV_NORMAL, POWER_SAMPLE_US);
+  }
+  TEST_ASSERT_EQUAL(TRIP_NONE, stage.tripped());
+  TEST_ASSERT_EQUAL(POWER_DUTY_FULL, stage.duty());
+  TEST_ASSERT_EQUAL(0, tripCalls);
+}
+
+//---tripped stays off whatever is read, and LOW keeps the reason for
+//   the screen; only the next HIGH clears it and ramps again
+void test_trip_latches( void )
+{
+  uint16_t before = stage.trips();
+  stage.set(HIGH);
+  feed(MV_SHORT, bcsjMillis(2));
+  TEST_ASSERT_EQUAL(TRIP_OVERCURRENT, stage.tripped());
+  feed(MV_NORMAL, bcsjMillis(POWER_RAMP_MS * 2));
+  TEST_ASSERT_EQUAL(0, stage.duty());
+
+  stage.set(LOW);
+  TEST_ASSERT_EQUAL(TRIP_OVERCURRENT, stage.tripped());
+  stage.set(HIGH);
+  TEST_ASSERT_EQUAL(TRIP_NONE, stage.tripped());
+  feed(MV_NORMAL, bcsjMillis(POWER_RAMP_MS + 10));
+  TEST_ASSERT_EQUAL(POWER_DUTY_FULL, stage.duty());
+  TEST_ASSERT_EQUAL(before + 1, stage.trips());
+  TEST_ASSERT_EQUAL(1, tripCalls);
+}
+
+//---LOW cuts at once, not down a ramp; HIGH twice does not restart it
+void test_cut_and_repeat( void )
+{
+  stage.set(HIGH);
+  feed(MV_NORMAL, bcsjMillis(POWER_RAMP_MS / 2));
+  uint8_t half = stage.duty();
+  stage.set(HIGH);
+  feed(MV_NORMAL, POWER_SAMPLE_US);
+  TEST_ASSERT_GREATER_OR_EQUAL(half, stage.duty());
+
+  stage.set(LOW);
+  TEST_ASSERT_EQUAL(0, stage.duty());
+  feed(MV_SHORT, bcsjMillis(2));           // readings while off change nothing
+  TEST_ASSERT_EQUAL(0, stage.duty());
+  TEST_ASSERT_EQUAL(TRIP_NONE, stage.tripped());
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_soft_start);
+  RUN_TEST(test_trip_under_1ms);
+  RUN_TEST(test_single_spike);
+  RUN_TEST(test_trip_latches);
+  RUN_TEST(test_cut_and_repeat);
+  return UNITY_END();
+}
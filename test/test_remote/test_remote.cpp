@@ -0,0 +1,323 @@
+//
+// Commands on the serial line: each action has to do what the knob and the
+// switch do, be refused where the panel could not do it, and come back the
+// same when a trace of it is replayed.
+// pio test -e native -f test_remote
+//
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+#include "inputTrace.h"
+#include "traceReplay.h"
+#include "yardSession.h"
+#include <nvs.h>
+
+extern U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2;
+
+static traceFile recorded;
+
+static bool inMenu( void )      { return u8g2.shows("Select Task"); }
+static bool trainsGone( void )  { return sim.idle(); }
+static bool dumped( void )      { return replay.decode(shimSerialOut, recorded); }
+
+
+void setUp( void )
+{
+}
+
+void tearDown( void )
+{
+}
+
+//---Parkersburg boots on track 1, route word 0
+void test_query( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+  TEST_ASSERT_EQUAL_STRING("MODE STAND_BY yard Parkersburg choice 1 active 1 aligned 1 power OFF occ 00000000",
+                           ask("m\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("SENS main 00 - passby 0 rev 00 - passby 0", ask("I\n").c_str());
+  TEST_ASSERT_EQUAL(0, ask("P\n").find("STATS boot_us "));
+}
+
+//---"A n" moves the same turnouts and opens the same window as the knob
+//   and a click on the panel
+void test_align_like_panel( void )
+{
+  sim.turn(2, bcsjMillis(200));
+  sim.click(bcsjSeconds(1));
+  sim.run(poweredUp, bcsjSeconds(30));
+  uint16_t panelRoute = sim.route();
+  unsigned track      = 0;
+  TEST_ASSERT_EQUAL(1, sscanf(ask("M\n").c_str(), "MODE TRACK_ACTIVE yard Parkersburg choice %u", &track));
+  TEST_ASSERT_EQUAL(2, track);
+  sim.run(poweredDown, bcsjMinutes(3));
+  bcsjTime64 panelWindow = sim.powerOffAt - sim.powerOnAt;
+  sim.run(standingBy, bcsjSeconds(5));
+
+  char line[16];
+  snprintf(line, sizeof(line), "S %u\n", track);
+  TEST_ASSERT_TRUE(bootParkersburg());                       // same start, from the serial line
+  TEST_ASSERT_EQUAL_STRING("OK", ask(line).c_str());
+  sim.run(NULL, bcsjSeconds(1));
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE STAND_BY yard Parkersburg choice 2 active 1 aligned 1"));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(sim.powered());
+  TEST_ASSERT_EQUAL_HEX16(panelRoute, sim.route());
+  sim.run(poweredDown, bcsjMinutes(3));
+  TEST_ASSERT_UINT64_WITHIN(bcsjMillis(100), panelWindow, sim.powerOffAt - sim.powerOnAt);
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---"X" is the double click: the window closes at once
+void test_cut_power( void )
+{
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 4\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.run(NULL, bcsjSeconds(5));
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE TRACK_ACTIVE"));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(poweredDown, bcsjSeconds(1));
+  TEST_ASSERT_FALSE(sim.powered());
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjSeconds(5), sim.powerOffAt - sim.powerOnAt);
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---"E" is a click during the move: a second window on the same track
+void test_extend( void )
+{
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 5\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("E\n").c_str());
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(poweredUp, bcsjSeconds(5));
+  TEST_ASSERT_TRUE(sim.powered());
+  TEST_ASSERT_EQUAL_HEX16(0x0007, sim.route());  // P5
+  sim.run(poweredDown, bcsjMinutes(3));
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjMinutes(1), sim.powerOffAt - sim.powerOnAt);
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---what the panel could not do at this point is refused
+void test_refused( void )
+{
+  TEST_ASSERT_EQUAL_STRING("ERR track", ask("S 9\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR track", ask("S\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR mode", ask("E\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR command", ask("Q\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR long", ask("S 11111111111111111111111111111111111111111111111111111111111111111\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR config", ask("C 0102\n").c_str());
+
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 2\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL_STRING("ERR mode", ask("S 3\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("ERR busy", ask("T\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("OK", ask("X\n").c_str());
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---skipOccupied: a train coming in is not offered an occupied track,
+//   and "S"/"A" say so instead of taking the next one; a train leaving
+//   one can still have it
+void test_skip_occupied( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.crntMap      = 1;
+  cfg.yardDelay[1] = 1;
+  cfg.flags        = CFG_SKIPOCCUPIED;
+  TEST_ASSERT_TRUE(sessionBoot(cfg));
+
+  simTrain in   = {SIM_MAIN, SIM_INBOUND, 5, 200, 0, 250};
+  simTrain slow = {SIM_MAIN, SIM_INBOUND, 10, 200, 0, 100};
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 3\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.train(in, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(standingBy, bcsjSeconds(5));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, ask("M\n").find("occ 00000008"));
+
+  TEST_ASSERT_EQUAL_STRING("OK", ask("S 2\n").c_str());
+  sim.train(slow, bcsjMillis(100));
+  sim.run(NULL, bcsjSeconds(2));                // on the beams, heading in
+  TEST_ASSERT_EQUAL_STRING("ERR occupied", ask("S 3\n").c_str());
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE STAND_BY yard Parkersburg choice 4"));
+  TEST_ASSERT_EQUAL_STRING("ERR occupied", ask("A 3\n").c_str());
+  sim.run(NULL, bcsjSeconds(2));
+  TEST_ASSERT_FALSE(sim.powered());
+  sim.run(trainsGone, bcsjSeconds(40));
+  sim.run(standingBy, bcsjSeconds(5));
+
+  TEST_ASSERT_EQUAL_STRING("OK", ask("S 3\n").c_str());  // nothing coming in
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE STAND_BY yard Parkersburg choice 3"));
+}
+
+//---a line that comes in pieces runs once, when it is complete
+void test_split_line( void )
+{
+  shimSerialOut.clear();
+  shimSerialFeed("M");
+  sim.run(NULL, bcsjMillis(500));
+  TEST_ASSERT_FALSE(replied());
+  shimSerialFeed("\r");
+  sim.run(replied, bcsjSeconds(1));
+  TEST_ASSERT_EQUAL(0, answer.find("MODE STAND_BY"));
+}
+
+//---the record comes out in hex, goes back with a change, and is applied
+//   like the menu's Accept & Exit, then kept
+void test_config( void )
+{
+  std::string hex = ask("C\n");
+  TEST_ASSERT_EQUAL(7 + 2 * sizeof(yardConfig), hex.size());
+  yardConfig cfg;
+  uint8_t   *raw = (uint8_t *)&cfg;
+  for (size_t i = 0; i < sizeof(cfg); i++) {
+    raw[i] = strtoul(hex.substr(7 + 2 * i, 2).c_str(), NULL, 16);
+  }
+  TEST_ASSERT_TRUE(configValid(cfg));
+  TEST_ASSERT_EQUAL(1, cfg.crntMap);
+
+  cfg.crntMap = 3;                         // Cumberland, default track 12
+  configSeal(cfg);
+  char line[80];
+  char *at = line + snprintf(line, sizeof(line), "C ");
+  for (size_t i = 0; i < sizeof(cfg); i++) at += snprintf(at, 3, "%02x", raw[i]);
+  snprintf(at, 2, "\n");
+  TEST_ASSERT_EQUAL_STRING("OK", ask(line).c_str());
+  sim.run(standingBy, bcsjSeconds(10));
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE STAND_BY yard Cumberland choice 12"));
+
+  yardConfig stored;
+  sim.run(NULL, bcsjSeconds(1));
+  TEST_ASSERT_TRUE(configLoad(stored));
+  TEST_ASSERT_EQUAL(3, stored.crntMap);
+}
+
+//---a window longer than the delay menu lists, set over "C", runs its
+//   whole time
+void test_long_window( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.crntMap      = 1;
+  cfg.yardDelay[1] = 120;
+  TEST_ASSERT_TRUE(sessionBoot(cfg));
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 2\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.run(poweredDown, bcsjMinutes(150));
+  TEST_ASSERT_FALSE(sim.powered());
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjMinutes(120), sim.powerOffAt - sim.powerOnAt);
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+//---a commit the flash refuses is tried again every interval_FlashRetry,
+//   not on every pass of the loop, and lands once the flash takes it
+void test_flash_retry( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+  simTrain in = {SIM_MAIN, SIM_INBOUND, 5, 200, 0, 250};
+  shimNvsFull = true;
+  TEST_ASSERT_EQUAL_STRING("OK", ask("A 3\n").c_str());
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.train(in, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(NULL, bcsjSeconds(10));
+  TEST_ASSERT_EQUAL(1, shimNvsRefused);
+  sim.run(NULL, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL(2, shimNvsRefused);
+
+  uint32_t occupancy[8] = {0};
+  shimNvsFull = false;
+  sim.run(NULL, bcsjSeconds(30));
+  TEST_ASSERT_EQUAL(2, shimNvsRefused);
+  TEST_ASSERT_TRUE(nvsReadBlob("occ", occupancy, sizeof(occupancy)));
+  TEST_ASSERT_EQUAL_HEX32(0x00000008, occupancy[1]);
+}
+
+//---a session driven from the serial line replays from its trace
+void test_replay( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+  simTrain out = {SIM_MAIN, SIM_OUTBOUND, 6, 200, 0, 300};
+  ask("A 4\n");
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.train(out, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(standingBy, bcsjSeconds(5));
+  ask("S 2\n");
+  sim.run(NULL, bcsjSeconds(1));
+  ask("A\n");
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.run(NULL, bcsjSeconds(3));
+  ask("X\n");
+  sim.run(standingBy, bcsjSeconds(5));
+
+  shimSerialOut.clear();
+  shimSerialFeed("T\n");
+  sim.run(dumped, bcsjSeconds(1));
+  TEST_ASSERT_TRUE(dumped());
+  size_t remote = 0;
+  for (size_t i = 0; i < recorded.events.size(); i++) {
+    if (recorded.events[i].kind == TRACE_PIN && recorded.events[i].arg == TRACE_REMOTE) remote++;
+  }
+  TEST_ASSERT_EQUAL(4, remote);
+
+  traceFile replayed;
+  traceDiff diff;
+  replay.run(recorded, replayed);
+  if (!replay.compare(recorded, replayed, diff)) {
+    TEST_FAIL_MESSAGE(diff.why);
+  }
+}
+
+//---the menu's Accept & Exit waits, like "C", until the lead is clear:
+//   no new yard and no turnouts thrown under a train
+void test_menu_waits_for_clear( void )
+{
+  const uint8_t keys[] = {U8X8_MSG_GPIO_MENU_SELECT,      // Yard
+                          U8X8_MSG_GPIO_MENU_PREV,        // Wheeling
+                          U8X8_MSG_GPIO_MENU_SELECT,
+                          U8X8_MSG_GPIO_MENU_NEXT,
+                          U8X8_MSG_GPIO_MENU_NEXT};       // Accept & Exit
+  TEST_ASSERT_TRUE(bootParkersburg());
+  uint16_t before = sim.route();
+  simTrain slow   = {SIM_MAIN, SIM_INBOUND, 10, 200, 0, 100};
+  sim.press(bcsjSeconds(7), bcsjMillis(200));   // opens the menu
+  sim.run(inMenu, bcsjSeconds(10));
+  for (size_t i = 0; i < sizeof(keys); i++) {
+    u8g2.press(keys[i]);
+    sim.run(NULL, bcsjMillis(500));
+  }
+  sim.train(slow, bcsjMillis(100));
+  sim.run(NULL, bcsjSeconds(2));                // on the beams, heading in
+  u8g2.press(U8X8_MSG_GPIO_MENU_SELECT);
+  sim.run(NULL, bcsjSeconds(2));
+  TEST_ASSERT_EQUAL(0, ask("M\n").find("MODE STAND_BY yard Parkersburg"));
+  TEST_ASSERT_EQUAL_HEX16(before, sim.route());
+
+  sim.run(trainsGone, bcsjSeconds(40));
+  sim.run(NULL, bcsjSeconds(2));
+  TEST_ASSERT_NOT_EQUAL(std::string::npos, ask("M\n").find("yard Wheeling"));
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_query);
+  RUN_TEST(test_align_like_panel);
+  RUN_TEST(test_cut_power);
+  RUN_TEST(test_extend);
+  RUN_TEST(test_refused);
+  RUN_TEST(test_skip_occupied);
+  RUN_TEST(test_split_line);
+  RUN_TEST(test_config);
+  RUN_TEST(test_long_window);
+  RUN_TEST(test_flash_retry);
+  RUN_TEST(test_replay);
+  RUN_TEST(test_menu_waits_for_clear);
+  return UNITY_END();
+}
@@ -0,0 +1,171 @@
+//
+// Operating sessions on the layout simulator: knob turns, clicks and trains
+// over the yard lead sensors, hundreds of moves per run.
+// pio test -e native -f test_sim
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include <time.h>
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+#include "yardSession.h"
+
+#define SESSION_MOVES  300
+
+static uint32_t seed = 12345;
+
+static uint32_t simRandom( uint32_t range )   // same session every run
+{
+  seed = seed * 1103515245UL + 12345UL;
+  return (seed >> 16) % range;
+}
+
+//---one move: pick a track, click, wait for power, run the train through
+static void move( const simTrain &t )
+{
+  sim.turn((int)simRandom(7) - 3, bcsjMillis(200));
+  sim.click(bcsjSeconds(2));
+  sim.run(poweredUp, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(sim.powered());
+  sim.train(t, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  TEST_ASSERT_FALSE(sim.powered());
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+
+void setUp( void )
+{
+}
+
+void tearDown( void )
+{
+}
+
+//---Parkersburg, 1 minute window
+void test_boot( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+  TEST_ASSERT_EQUAL(0, sim.stats.darkRuns);
+}
+
+//---every outbound train ends its window at the PassBy, inbound ones time out
+void test_session( void )
+{
+  simStats   before  = sim.stats;
+  bcsjTime64 began   = bcsjNow();
+  clock_t    cpu     = clock();
+  uint32_t   outbound = 0;
+
+  for (int i = 0; i < SESSION_MOVES; i++) {
+    simTrain t;
+    t.sensor    = SIM_MAIN;
+    t.direction = simRandom(10) < 7 ? SIM_OUTBOUND : SIM_INBOUND;
+    t.cars      = 3 + simRandom(18);
+    t.carMm     = 150 + simRandom(100);
+    t.gapMm     = 0;
+    t.speedMmS  = 100 + simRandom(500);
+    if (t.direction == SIM_OUTBOUND) outbound++;
+    move(t);
+  }
+
+  double virtualSec = (double)(bcsjNow() - began) / 1e6;
+  double realSec    = (double)(clock() - cpu) / CLOCKS_PER_SEC;
+  char   line[96];
+  snprintf(line, sizeof(line), "%d moves, %.0f s of layout time in %.2f s, %.0fx",
+           SESSION_MOVES, virtualSec, realSec, virtualSec / (realSec > 0 ? realSec : 1e-3));
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL(SESSION_MOVES, sim.stats.windows - before.windows);
+  TEST_ASSERT_EQUAL(0, sim.stats.darkRuns);
+  TEST_ASSERT_EQUAL(outbound, sim.stats.passbyEnds - before.passbyEnds);
+  TEST_ASSERT_EQUAL(SESSION_MOVES - outbound, sim.stats.timeouts - before.timeouts);
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjMinutes(1), sim.stats.longestWindow);
+  //---a move back to the track already aligned latches nothing
+  TEST_ASSERT_GREATER_THAN(SESSION_MOVES / 2, sim.stats.routes - before.routes);
+}
+
+//---a car shorter than the beam gap never covers both beams: no PassBy,
+//   the window runs its full time
+void test_short_car_times_out( void )
+{
+  simStats before = sim.stats;
+  simTrain t = {SIM_MAIN, SIM_OUTBOUND, 1, 40, 0, 200};
+  move(t);
+  TEST_ASSERT_EQUAL(1, sim.stats.timeouts - before.timeouts);
+  TEST_ASSERT_EQUAL(0, sim.stats.passbyEnds - before.passbyEnds);
+}
+
+//---daylight between cars flickers the beams, the train still reads as one
+void test_coupler_gaps( void )
+{
+  simStats before = sim.stats;
+  simTrain t = {SIM_MAIN, SIM_OUTBOUND, 12, 180, 12, 300};
+  move(t);
+  TEST_ASSERT_EQUAL(1, sim.stats.passbyEnds - before.passbyEnds);
+}
+
+#define RL_ROUTE  0x000F                   // Wheeling routes[numTracks]
+
+static uint16_t   aligned;
+static bool       loopPowered;
+static bcsjTime64 leftLoopAt;
+
+//---watches one run from the loop train to the route being put back;
+//   the firmware is never stopped in between
+static bool backOnTrack( void )
+{
+  if (sim.route() == RL_ROUTE) {
+    if (sim.powered()) loopPowered = true;
+  }
+  else if (loopPowered && leftLoopAt == 0) {
+    leftLoopAt = bcsjNow();
+  }
+  return leftLoopAt != 0 && standingBy();
+}
+
+//---Wheeling with the automatic reverse loop: a train off the loop gets
+//   the RL route and power, which stay until it is out through mainSens;
+//   then the route the yard had is put back
+void test_rev_loop( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.crntMap = 0;
+  cfg.flags   = CFG_AUTOREVLOOP;
+  TEST_ASSERT_TRUE(sessionBoot(cfg));
+
+  simTrain in  = {SIM_MAIN, SIM_INBOUND, 4, 200, 0, 300};
+  sim.turn(-3, bcsjMillis(200));
+  sim.click(bcsjSeconds(2));
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.train(in, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(standingBy, bcsjSeconds(5));
+  aligned = sim.route();
+  TEST_ASSERT_NOT_EQUAL(RL_ROUTE, aligned);
+
+  simTrain loop = {SIM_REV, SIM_INBOUND, 20, 200, 0, 300}; // still on it with power
+  simTrain out  = {SIM_MAIN, SIM_OUTBOUND, 4, 200, 0, 300};
+  loopPowered = false;
+  leftLoopAt  = 0;
+  sim.train(loop, bcsjSeconds(1));
+  bcsjTime64 outClear = sim.train(out, bcsjSeconds(40));  // a while on the ladder
+  sim.run(backOnTrack, bcsjMinutes(1));
+  TEST_ASSERT_TRUE(loopPowered);
+  TEST_ASSERT_GREATER_OR_EQUAL(outClear, leftLoopAt);     // not before it is out
+  TEST_ASSERT_EQUAL_HEX16(aligned, sim.route());
+  TEST_ASSERT_FALSE(sim.powered());
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_boot);
+  RUN_TEST(test_session);
+  RUN_TEST(test_short_car_times_out);
+  RUN_TEST(test_coupler_gaps);
+  RUN_TEST(test_rev_loop);
+  return UNITY_END();
+}
@@ -0,0 +1,113 @@
+//
+// Sensor storm benchmark on the host: every case through the firmware's own
+// readMainSens()/readRevSens(), with the numbers printed for each build.
+// The board runs the same cases when it gets "B" on the serial line
+// (build with -DSENSOR_BENCH=1, pio run -e esp32dev_bench).
+// pio test -e native -f test_storm
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include <time.h>
+#include "bcsjTimer.h"
+#include "sensorStorm.h"
+#include <nvs.h>
+
+void setup();
+void benchRun(uint8_t id);
+extern bool benchPassBy;
+
+#define PASS_US     100                    // BENCH_HOST_PASS
+#define DEBOUNCE_US 5000                   // configDefaults() debounceMs
+
+static stormResult bench( uint8_t id )
+{
+  clock_t cpu = clock();
+  shimSerialOut.clear();
+  benchRun(id);
+  double ns = (double)(clock() - cpu) * 1e9 / CLOCKS_PER_SEC / storm.result.passes;
+  char line[48];
+  snprintf(line, sizeof(line), " host_ns_per_pass %.0f", ns);
+  shimSerialOut.erase(shimSerialOut.find_last_not_of("\r\n") + 1);
+  TEST_MESSAGE((shimSerialOut + line).c_str());
+  return storm.result;
+}
+
+
+void setUp( void )
+{
+}
+
+void tearDown( void )
+{
+}
+
+//---a clean outbound PassBy: every edge seen once debounce has run out
+void test_clean( void )
+{
+  stormResult r = bench(STORM_CLEAN);
+  TEST_ASSERT_EQUAL(4, r.settled);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.spurious);
+  TEST_ASSERT_LESS_OR_EQUAL(DEBOUNCE_US + 1000 + 2 * PASS_US, r.latencyMax);  // millis() steps
+  TEST_ASSERT_TRUE(benchPassBy);
+}
+
+//---IR receivers hunting at each edge still give one change per edge
+void test_chatter( void )
+{
+  stormResult r = bench(STORM_CHATTER);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.spurious);
+  TEST_ASSERT_TRUE(benchPassBy);
+}
+
+//---1 ms blips never reach the report
+void test_glitch( void )
+{
+  stormResult r = bench(STORM_GLITCH);
+  TEST_ASSERT_EQUAL(0, r.settled);
+  TEST_ASSERT_EQUAL(0, r.spurious);
+  TEST_ASSERT_FALSE(benchPassBy);
+}
+
+//---all four beams in the same instant, both readers keep up
+void test_allpins( void )
+{
+  stormResult r = bench(STORM_ALLPINS);
+  TEST_ASSERT_EQUAL(8, r.settled);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.spurious);
+}
+
+//---a car shorter than the pair spacing: edges seen, but no PassBy
+void test_shortcar( void )
+{
+  stormResult r = bench(STORM_SHORTCAR);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_FALSE(benchPassBy);
+}
+
+//---the reverse loop pair decodes the same way
+void test_revpass( void )
+{
+  stormResult r = bench(STORM_REVPASS);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.spurious);
+  TEST_ASSERT_TRUE(benchPassBy);
+}
+
+int main( int argc, char **argv )
+{
+  shimNvsErase();
+  shimReset();
+  setup();
+  UNITY_BEGIN();
+  RUN_TEST(test_clean);
+  RUN_TEST(test_chatter);
+  RUN_TEST(test_glitch);
+  RUN_TEST(test_allpins);
+  RUN_TEST(test_shortcar);
+  RUN_TEST(test_revpass);
+  return UNITY_END();
+}
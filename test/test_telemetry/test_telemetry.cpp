@@ -0,0 +1,172 @@
+//
+// Telemetry stream: COBS frames with their CRC, the TX ring when the UART
+// has no room, and the frames the firmware sends from boot on.
+// pio test -e native -f test_telemetry
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "bcsjTimer.h"
+#include "telemetry.h"
+#include <nvs.h>
+
+void setup();
+void logState(byte state);
+
+struct frame { std::vector<uint8_t> raw; };
+
+static uint8_t crc8( const uint8_t *data, size_t len )
+{
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+//---split on zeros, undo COBS, keep the chunks whose CRC holds
+static std::vector<frame> frames( const std::string &out, size_t *text = NULL )
+{
+  std::vector<frame> found;
+  size_t start = 0;
+  if (text) *text = 0;
+  while (start < out.size()) {
+    size_t end = out.find('\0', start);
+    if (end == std::string::npos) end = out.size();
+    std::vector<uint8_t> dec;
+    bool   ok = end > start;
+    size_t i  = start;
+    while (ok && i < end) {
+      uint8_t code = out[i++];
+      if (code == 0 || i + code - 1 > end) { ok = false; break; }
+      for (int k = 1; k < code; k++) dec.push_back(out[i++]);
+      if (code < 0xFF && i < end) dec.push_back(0);
+    }
+    if (ok && dec.size() >= 6 && crc8(dec.data(), dec.size() - 1) == dec.back()) {
+      frame f;
+      f.raw.assign(dec.begin(), dec.end() - 1);
+      found.push_back(f);
+    }
+    else if (end > start && text) {
+      *text += end - start;
+    }
+    start = end + 1;
+  }
+  return found;
+}
+
+
+void setUp( void )
+{
+  shimReset();
+  telemetry.begin(Serial);
+}
+
+void tearDown( void )
+{
+}
+
+//---a route word full of zero bytes comes back whole
+void test_route_frame( void )
+{
+  telemetry.route(3, 0x0100);
+  std::vector<frame> f = frames(shimSerialOut);
+  TEST_ASSERT_EQUAL(1, f.size());
+  TEST_ASSERT_EQUAL(LOG_EV_ROUTE, f[0].raw[0]);
+  TEST_ASSERT_EQUAL(9, f[0].raw.size());
+  TEST_ASSERT_EQUAL(3, f[0].raw[5] | (f[0].raw[6] << 8));
+  TEST_ASSERT_EQUAL(0x0100, f[0].raw[7] | (f[0].raw[8] << 8));
+  TEST_ASSERT_EQUAL(0, telemetry.pending());
+}
+
+//---a long message is cut, never split across frames
+void test_text_frame( void )
+{
+  telemetry.text(LOG_WARN, "IDLE: light sleep not available, this line runs on well past the limit");
+  std::vector<frame> f = frames(shimSerialOut);
+  TEST_ASSERT_EQUAL(1, f.size());
+  TEST_ASSERT_EQUAL(LOG_EV_TEXT, f[0].raw[0]);
+  TEST_ASSERT_EQUAL(LOG_WARN, f[0].raw[5]);
+  TEST_ASSERT_EQUAL(6 + TELEMETRY_TEXT, f[0].raw.size());
+}
+
+//---with the UART full nothing is written and nothing waits; what does not
+//   fit is counted and reported once there is room
+void test_full_uart_drops( void )
+{
+  shimTxRoom = 0;
+  for (int i = 0; i < 100; i++) {
+    telemetry.timing(LOG_T_FLASH_COMMIT, 1000 + i);
+  }
+  TEST_ASSERT_EQUAL(0, shimSerialOut.size());
+  TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_RING, telemetry.pending());
+  uint16_t lost = telemetry.dropped();
+  TEST_ASSERT_GREATER_THAN(0, lost);
+
+  shimTxRoom = 16;                         // drains a bit per pass
+  while (telemetry.pending()) telemetry.pump();
+  telemetry.timing(LOG_T_FLASH_COMMIT, 7);
+  while (telemetry.pending()) telemetry.pump();
+  std::vector<frame> f = frames(shimSerialOut);
+  TEST_ASSERT_EQUAL(100 - lost + 2, f.size());
+  TEST_ASSERT_EQUAL(LOG_EV_DROPPED, f[f.size() - 2].raw[0]);
+  TEST_ASSERT_EQUAL(lost, f[f.size() - 2].raw[5] | (f[f.size() - 2].raw[6] << 8));
+  TEST_ASSERT_EQUAL(0, telemetry.dropped());
+}
+
+//---text written straight to Serial between frames is left alone
+void test_text_between_frames( void )
+{
+  size_t text;
+  telemetry.mode(1, 2);
+  Serial.print("BENCH clean settled 8\r\n");
+  telemetry.mode(2, 3);
+  std::vector<frame> f = frames(shimSerialOut, &text);
+  TEST_ASSERT_EQUAL(2, f.size());
+  TEST_ASSERT_EQUAL(23, text);
+}
+
+//---only a change of state is sent
+void test_state_changes( void )
+{
+  logState(1);
+  logState(1);
+  logState(2);
+  logState(2);
+  std::vector<frame> f = frames(shimSerialOut);
+  TEST_ASSERT_EQUAL(2, f.size());
+  TEST_ASSERT_EQUAL(LOG_EV_MODE, f[1].raw[0]);
+  TEST_ASSERT_EQUAL(1, f[1].raw[5]);
+  TEST_ASSERT_EQUAL(2, f[1].raw[6]);
+}
+
+//---boot sends the first sample time and the default route
+void test_boot_frames( void )
+{
+  shimNvsErase();
+  setup();
+  std::vector<frame> f = frames(shimSerialOut);
+  bool route = false, sample = false;
+  for (size_t i = 0; i < f.size(); i++) {
+    if (f[i].raw[0] == LOG_EV_ROUTE) route = true;
+    if (f[i].raw[0] == LOG_EV_TIMING && f[i].raw[5] == LOG_T_BOOT_SAMPLE) sample = true;
+  }
+  TEST_ASSERT_TRUE(route);
+  TEST_ASSERT_TRUE(sample);
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_route_frame);
+  RUN_TEST(test_text_frame);
+  RUN_TEST(test_full_uart_drops);
+  RUN_TEST(test_text_between_frames);
+  RUN_TEST(test_state_changes);
+  RUN_TEST(test_boot_frames);
+  return UNITY_END();
+}
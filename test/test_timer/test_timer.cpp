@@ -0,0 +1,132 @@
+//
+// bcsjTimer and the bcsjTimers deadline heap on the virtual clock.
+// pio test -e native -f test_timer
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+
+static int fireOrder[4];
+static int fireCount;
+
+static void recordFire( bcsjTimer *timer );
+
+bcsjTimer timerA, timerB, timerC;
+
+
+void setUp( void )
+{
+  shimReset();
+  timerA.disable(); timerB.disable(); timerC.disable();
+  fireCount = 0;
+}
+
+void tearDown( void )
+{
+}
+
+static void recordFire( bcsjTimer *timer )
+{
+  fireOrder[fireCount++] = (timer == &timerA) ? 'A' : (timer == &timerB) ? 'B' : 'C';
+}
+
+//---a timer is running up to its deadline and done from then on
+void test_timer_deadline( void )
+{
+  timerA.start(bcsjSeconds(3));
+  bcsjClockAdvance(bcsjSeconds(3) - 1);
+  TEST_ASSERT_TRUE(timerA.running());
+  bcsjClockAdvance(1);
+  TEST_ASSERT_TRUE(timerA.done());
+  TEST_ASSERT_EQUAL_UINT64(0, timerA.test());
+}
+
+//---the 6 minute power window, jumped in one call instead of waited out
+void test_six_minute_window( void )
+{
+  bcsjTime64 began = bcsjNow();
+  timerA.start(bcsjMinutes(6));
+  TEST_ASSERT_EQUAL_UINT64(bcsjMinutes(6), bcsjTimers.untilNext());
+  bcsjTimers.waitNext(bcsjHours(1));
+  TEST_ASSERT_EQUAL_UINT64(bcsjMinutes(6), bcsjNow() - began);
+  TEST_ASSERT_TRUE(timerA.done());
+}
+
+//---micros() wraps at 71.6 minutes, the timers do not
+void test_window_across_micros_wrap( void )
+{
+  bcsjClockSet(0xFFFFFFFFULL - bcsjSeconds(30));
+  timerA.start(bcsjMinutes(2));
+  bcsjClockAdvance(bcsjMinutes(1));
+  TEST_ASSERT_TRUE(micros() < bcsjSeconds(60));
+  TEST_ASSERT_TRUE(timerA.running());
+  bcsjClockAdvance(bcsjMinutes(1));
+  TEST_ASSERT_TRUE(timerA.done());
+}
+
+//---poll() fires callbacks in deadline order, not start order
+void test_poll_fires_in_deadline_order( void )
+{
+  timerA.attach(recordFire); timerB.attach(recordFire); timerC.attach(recordFire);
+  timerA.start(bcsjMillis(300));
+  timerB.start(bcsjMillis(100));
+  timerC.start(bcsjMillis(200));
+  bcsjClockAdvance(bcsjMillis(150));
+  bcsjTimers.poll();
+  TEST_ASSERT_EQUAL(1, fireCount);
+  bcsjClockAdvance(bcsjMillis(200));
+  bcsjTimers.poll();
+  TEST_ASSERT_EQUAL(3, fireCount);
+  TEST_ASSERT_EQUAL('B', fireOrder[0]);
+  TEST_ASSERT_EQUAL('C', fireOrder[1]);
+  TEST_ASSERT_EQUAL('A', fireOrder[2]);
+  TEST_ASSERT_FALSE(bcsjTimers.pending());
+  timerA.attach(NULL); timerB.attach(NULL); timerC.attach(NULL);
+}
+
+//---a disabled timer leaves the heap and never fires
+void test_disable_cancels( void )
+{
+  timerA.attach(recordFire);
+  timerA.start(bcsjMillis(10));
+  timerA.disable();
+  bcsjClockAdvance(bcsjMillis(20));
+  bcsjTimers.poll();
+  TEST_ASSERT_EQUAL(0, fireCount);
+  TEST_ASSERT_FALSE(timerA.active());
+  timerA.attach(NULL);
+}
+
+//---with every heap slot taken a timer is counted as an overflow, and
+//   running() still lets go of it at its deadline
+void test_full_heap( void )
+{
+  static bcsjTimer fill[BCSJ_MAX_TIMERS];
+  for (int i = 0; i < BCSJ_MAX_TIMERS; i++) {
+    fill[i].start(bcsjHours(1));
+  }
+  uint16_t before = bcsjTimers.overflows();
+  timerA.start(bcsjSeconds(3));
+  TEST_ASSERT_EQUAL(before + 1, bcsjTimers.overflows());
+  TEST_ASSERT_TRUE(timerA.running());
+  bcsjClockAdvance(bcsjSeconds(3));
+  TEST_ASSERT_FALSE(timerA.running());
+  TEST_ASSERT_TRUE(timerA.done());
+  for (int i = 0; i < BCSJ_MAX_TIMERS; i++) {
+    fill[i].disable();
+  }
+  TEST_ASSERT_FALSE(bcsjTimers.pending());
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_timer_deadline);
+  RUN_TEST(test_six_minute_window);
+  RUN_TEST(test_window_across_micros_wrap);
+  RUN_TEST(test_poll_fires_in_deadline_order);
+  RUN_TEST(test_disable_cancels);
+  RUN_TEST(test_full_heap);
+  return UNITY_END();
+}
@@ -0,0 +1,24 @@
+// sim_two_moves - input trace, 47 records, 79.7 s, 299 bytes
+// made by tools/traceGrab.py --c-array
+
+static const uint8_t sim_two_moves[] = {
+  0x42, 0x54, 0x52, 0x43, 0x01, 0x43, 0x2f, 0x00, 0x00, 0x00, 0x90, 0xba, 0xbf, 0x04, 0xd4, 0x00,
+  0x00, 0x00, 0x03, 0x63, 0x66, 0x67, 0x19, 0x59, 0x43, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x01, 0x01, 0xb8, 0x0b, 0x05, 0x00, 0x3c, 0x00, 0xd0, 0x07, 0x00, 0x00, 0x0f, 0x31, 0x08,
+  0x03, 0x6f, 0x63, 0x63, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x01, 0x00, 0x1b, 0x01, 0x00, 0x0e, 0x01, 0x00, 0x0c,
+  0x01, 0x00, 0x11, 0x01, 0x00, 0x10, 0x01, 0x00, 0x04, 0x01, 0x00, 0x80, 0x01, 0x00, 0xc0, 0x07,
+  0xe0, 0x5d, 0x40, 0x00, 0xb0, 0xc5, 0xb1, 0x02, 0x80, 0x00, 0x00, 0xc0, 0x01, 0xa0, 0xfb, 0x0b,
+  0x10, 0x00, 0xe0, 0xda, 0x01, 0x11, 0x00, 0xe0, 0xda, 0x01, 0x10, 0x01, 0xe0, 0xda, 0x01, 0x11,
+  0x01, 0xb0, 0x6d, 0x10, 0x00, 0xe0, 0xda, 0x01, 0x11, 0x00, 0xe0, 0xda, 0x01, 0x10, 0x01, 0xe0,
+  0xda, 0x01, 0x11, 0x01, 0xa8, 0x97, 0x63, 0x04, 0x00, 0x80, 0xeb, 0x06, 0x04, 0x01, 0x88, 0xdc,
+  0x18, 0xc0, 0x02, 0xe0, 0x5d, 0x40, 0x10, 0xc0, 0x8d, 0xb7, 0x01, 0x80, 0x01, 0xc0, 0xbb, 0x01,
+  0xc0, 0x03, 0xc0, 0x87, 0x3c, 0x1b, 0x00, 0xc0, 0xa0, 0x0a, 0x1a, 0x00, 0xc0, 0xf8, 0xba, 0x02,
+  0x1b, 0x01, 0xc0, 0xa0, 0x0a, 0x1a, 0x01, 0x90, 0xcb, 0x01, 0x80, 0x00, 0x00, 0xc0, 0x01, 0xa0,
+  0xfb, 0x0b, 0x11, 0x00, 0xe0, 0xda, 0x01, 0x10, 0x00, 0xe0, 0xda, 0x01, 0x11, 0x01, 0xe0, 0xda,
+  0x01, 0x10, 0x01, 0xf8, 0x94, 0x69, 0x04, 0x00, 0x80, 0xeb, 0x06, 0x04, 0x01, 0x88, 0xdc, 0x18,
+  0xc0, 0x02, 0xe0, 0x5d, 0x80, 0x01, 0xc0, 0xbb, 0x01, 0xc0, 0x03, 0xc0, 0x87, 0x3c, 0x1a, 0x00,
+  0x80, 0xdc, 0x0b, 0x1b, 0x00, 0xe0, 0x96, 0xe8, 0x01, 0x1a, 0x01, 0xe0, 0xb9, 0x0c, 0x1b, 0x01,
+  0x90, 0xa5, 0x93, 0x1a, 0x80, 0x00, 0x00, 0xc0, 0x01, 0x61, 0xc3,
+};
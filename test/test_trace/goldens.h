@@ -0,0 +1,18 @@
+//
+// Traces the replay in test_trace has to reproduce.  Make one with
+//   tools/traceGrab.py --log session.trc --c-array NAME golden/NAME.h
+// then include it and add a line to the table.
+//
+
+#include "golden/sim_two_moves.h"          // layout simulator, Parkersburg, 1 minute
+
+struct goldenTrace
+{
+  const char    *name;
+  const uint8_t *bytes;
+  size_t         len;
+};
+
+static const goldenTrace goldens[] = {
+  {"sim_two_moves", sim_two_moves, sizeof(sim_two_moves)},
+};
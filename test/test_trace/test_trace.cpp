@@ -0,0 +1,154 @@
+//
+// Input traces: a session recorded on the layout simulator, dumped over the
+// serial line with "T" like on the board, then played back into a freshly
+// booted firmware.  The replay has to drive the same outputs at the same
+// times.  Traces grabbed from the layout with tools/traceGrab.py go in
+// goldens.h and are held to the same standard.
+// pio test -e native -f test_trace
+//
+
+#include <Arduino.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+#include "inputTrace.h"
+#include "traceReplay.h"
+#include "yardSession.h"
+#include "goldens.h"
+
+static traceFile recorded;
+
+static bool dumped( void )      { return shimSerialOut.find("BTRC") != std::string::npos &&
+                                         replay.decode(shimSerialOut, recorded); }
+
+static void move( int detents, const simTrain &t )
+{
+  sim.turn(detents, bcsjMillis(200));
+  sim.click(bcsjSeconds(2));
+  sim.run(poweredUp, bcsjSeconds(30));
+  sim.train(t, bcsjSeconds(1));
+  sim.run(poweredDown, bcsjMinutes(3));
+  sim.run(standingBy, bcsjSeconds(5));
+}
+
+static size_t countKind( const traceFile &t, uint8_t kind )
+{
+  size_t n = 0;
+  for (size_t i = 0; i < t.events.size(); i++) {
+    if (t.events[i].kind == kind) n++;
+  }
+  return n;
+}
+
+static void replayMatches( const traceFile &golden )
+{
+  traceFile replayed;
+  traceDiff diff;
+  replay.run(golden, replayed);
+  if (!replay.compare(golden, replayed, diff)) {
+    TEST_FAIL_MESSAGE(diff.why);
+  }
+}
+
+
+void setUp( void )
+{
+}
+
+void tearDown( void )
+{
+}
+
+//---Parkersburg, 1 minute window: an outbound train that ends its window
+//   at the PassBy, an inbound one that times out, then "T"
+void test_record( void )
+{
+  TEST_ASSERT_TRUE(bootParkersburg());
+  simStats before = sim.stats;
+
+  simTrain out = {SIM_MAIN, SIM_OUTBOUND, 8, 200, 0, 300};
+  simTrain in  = {SIM_MAIN, SIM_INBOUND,  5, 200, 0, 250};
+  move(2, out);
+  move(-1, in);
+  TEST_ASSERT_EQUAL(1, sim.stats.passbyEnds - before.passbyEnds);
+  TEST_ASSERT_EQUAL(1, sim.stats.timeouts - before.timeouts);
+
+  shimSerialOut.clear();
+  shimSerialFeed("T\n");
+  sim.run(dumped, bcsjSeconds(1));
+  TEST_ASSERT_TRUE(dumped());
+  TEST_ASSERT_EQUAL(0, recorded.lost);
+  TEST_ASSERT_EQUAL(2, recorded.boot.size());
+  TEST_ASSERT_EQUAL_STRING(YARD_CONFIG_KEY, recorded.boot[0].key.c_str());
+  TEST_ASSERT_EQUAL(sizeof(yardConfig), recorded.boot[0].data.size());
+  TEST_ASSERT_GREATER_OR_EQUAL(2, countKind(recorded, TRACE_ROUTE));
+  TEST_ASSERT_EQUAL(6, countKind(recorded, TRACE_POWER));  // boot lamp, then 2 windows
+
+  char line[64];
+  snprintf(line, sizeof(line), "%u records, %llu s", (unsigned)recorded.events.size(),
+           (unsigned long long)(recorded.span / 1000000ULL));
+  TEST_MESSAGE(line);
+}
+
+//---a damaged frame is refused, not half read
+void test_decode_checks_crc( void )
+{
+  std::string frame = shimSerialOut;
+  traceFile   t;
+  frame[frame.find("BTRC") + 30] ^= 0x10;
+  TEST_ASSERT_FALSE(replay.decode(frame, t));
+}
+
+void test_replay_matches( void )
+{
+  replayMatches(recorded);
+  replayMatches(recorded);
+}
+
+//---the same session without its outbound train: the window runs the full
+//   minute, the replay has to say so
+void test_replay_catches_change( void )
+{
+  traceFile edited = recorded;
+  std::vector<traceEvent> kept;
+  bool seenPower = false;
+  for (size_t i = 0; i < edited.events.size(); i++) {
+    const traceEvent &e = edited.events[i];
+    if (e.kind == TRACE_POWER && e.value == HIGH && e.at > bcsjSeconds(1)) seenPower = true;
+    if (e.kind == TRACE_PIN && (e.arg == 26 || e.arg == 27) && seenPower &&
+        e.at < bcsjSeconds(1) + bcsjMinutes(1)) {
+      continue;                            // mainSensInpin, mainSensOutpin
+    }
+    kept.push_back(e);
+  }
+  edited.events = kept;
+
+  traceFile replayed;
+  traceDiff diff;
+  replay.run(edited, replayed);
+  TEST_ASSERT_FALSE(replay.compare(edited, replayed, diff));
+  TEST_ASSERT_GREATER_THAN(bcsjSeconds(1), diff.want.at);
+  TEST_MESSAGE(diff.why);
+}
+
+void test_goldens( void )
+{
+  for (size_t i = 0; i < sizeof(goldens) / sizeof(goldens[0]); i++) {
+    traceFile golden;
+    TEST_ASSERT_TRUE_MESSAGE(replay.decode(goldens[i].bytes, goldens[i].len, golden),
+                             goldens[i].name);
+    TEST_MESSAGE(goldens[i].name);
+    replayMatches(golden);
+  }
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_record);
+  RUN_TEST(test_decode_checks_crc);
+  RUN_TEST(test_replay_matches);
+  RUN_TEST(test_replay_catches_change);
+  RUN_TEST(test_goldens);
+  return UNITY_END();
+}
@@ -0,0 +1,245 @@
+//
+// The whole firmware, setup() and loop() from src/main.cpp, run against the
+// Arduino shim.  The panel, the power relay and the shift register are only
+// looked at from the outside: shown text, pin levels and the latched word.
+// pio test -e native -f test_yard
+//
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <unity.h>
+#include "bcsjTimer.h"
+#include "yardConfig.h"
+#include <nvs.h>
+
+void setup();
+void loop();
+extern U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2;
+
+const uint8_t powerPin   = 2;      // trackPowerLED_PIN
+const uint8_t switchPin  = 4;      // encoderSwPin
+const uint8_t mainInPin  = 26;     // mainSensInpin
+const uint8_t mainOutPin = 27;     // mainSensOutpin
+
+//
+// loop() only returns between states and STAND_BY never returns on its own,
+// so the firmware is run from inside its own pin reads: the read hook plays
+// the scripted pin changes, notes when track power switches, and throws
+// once the run should end.
+//
+struct runStop {};
+struct pinStep { bcsjTime64 at; uint8_t pin; uint8_t level; };
+
+static pinStep     script[16];
+static int         scriptLen;
+static bcsjTime64  stopAt;
+static bool      (*stopWhen)( void );
+static bool        inHook, inRun;
+static uint8_t     powerLevel;
+static bcsjTime64  powerOnAt, powerOffAt;
+
+static void scriptHook( uint8_t pin )
+{
+  (void)pin;
+  if (inHook) return;                          // the switch ISR reads the pin too
+  inHook = true;
+  bcsjTime64 now = bcsjNow();
+  for (int i = 0; i < scriptLen; i++) {
+    if (script[i].at && now >= script[i].at) {
+      script[i].at = 0;
+      shimSetPin(script[i].pin, script[i].level);
+    }
+  }
+  if (shimPinLevel[powerPin] != powerLevel) {
+    powerLevel = shimPinLevel[powerPin];
+    if (powerLevel == HIGH) powerOnAt  = now;
+    else                    powerOffAt = now;
+  }
+  inHook = false;
+  if (inRun && (now >= stopAt || (stopWhen && stopWhen()))) throw runStop();
+}
+
+//---run the firmware until done() is true, or for limit at most
+static void runUntil( bool (*done)( void ), bcsjTime64 limit )
+{
+  stopWhen = done;
+  stopAt   = bcsjNow() + limit;
+  inRun    = true;
+  try {
+    for (;;) loop();
+  }
+  catch (runStop &) {
+  }
+  inRun    = false;
+}
+
+static void pinIn( bcsjTime64 delay, uint8_t pin, uint8_t level )
+{
+  if (scriptLen == 16) scriptLen = 0;
+  script[scriptLen++] = {bcsjNow() + delay, pin, level};
+}
+
+static void clickIn( bcsjTime64 delay )
+{
+  pinIn(delay, switchPin, LOW);
+  pinIn(delay + bcsjMillis(120), switchPin, HIGH);
+}
+
+static void bootWith( void )
+{
+  shimReset();
+  shimReadStepUs = 1000;                       // 1 ms of virtual time per pin read
+  shimReadHook   = scriptHook;
+  scriptLen      = 0;
+  setup();
+}
+
+static bool standingBy( void )   { return u8g2.shows("Rotate"); }
+static bool powerCycled( void )  { return powerOnAt != 0 && powerOffAt > powerOnAt; }
+static bool inMenu( void )       { return u8g2.shows("Select Task"); }
+
+
+void setUp( void )
+{
+}
+
+void tearDown( void )
+{
+}
+
+//---blank NVS: defaults are written back, Test yard splash
+void test_boot_defaults( void )
+{
+  shimNvsErase();
+  bootWith();
+  TEST_ASSERT_TRUE(u8g2.shows("STARTING UP!"));
+  TEST_ASSERT_TRUE(u8g2.shows("Test"));
+  runUntil(standingBy, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(u8g2.shows("Rotate"));
+  TEST_ASSERT_EQUAL(LOW, shimPinLevel[powerPin]);
+  yardConfig stored;
+  runUntil(NULL, bcsjSeconds(1));              // quiet yard, the deferred write lands
+  TEST_ASSERT_TRUE(configLoad(stored));
+  TEST_ASSERT_EQUAL(4, stored.crntMap);
+}
+
+//---any delay the record holds is kept, hours long ones set over the
+//   serial line too; old EEPROM delays come over as they were.  An
+//   auto-route policy out of range makes the record bad, and the board
+//   boots on defaults
+void test_config_ranges( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.yardDelay[2] = 255;
+  configSeal(cfg);
+  TEST_ASSERT_TRUE(configValid(cfg));
+  configDefaults(cfg);
+  cfg.autoRoutePolicy = AUTO_POLICIES;
+  configSeal(cfg);
+  TEST_ASSERT_FALSE(configValid(cfg));
+
+  configDefaults(cfg);
+  configMigrate(cfg, 6, 45);
+  TEST_ASSERT_EQUAL(45, cfg.yardDelay[6]);
+  TEST_ASSERT_TRUE(configValid(cfg));
+  configDefaults(cfg);
+  configMigrate(cfg, 6, 255);
+  TEST_ASSERT_EQUAL(1, cfg.yardDelay[6]);
+
+  configDefaults(cfg);
+  cfg.crntMap      = 6;
+  cfg.yardDelay[6] = 120;
+  TEST_ASSERT_TRUE(configSave(cfg));
+  bootWith();
+  TEST_ASSERT_TRUE(u8g2.shows("Curtis Bay"));
+  runUntil(standingBy, bcsjSeconds(30));
+
+  configDefaults(cfg);
+  cfg.crntMap         = 6;
+  cfg.autoRoutePolicy = AUTO_POLICIES;
+  TEST_ASSERT_TRUE(configSave(cfg));
+  bootWith();
+  TEST_ASSERT_TRUE(u8g2.shows("Test"));
+  runUntil(standingBy, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(configLoad(cfg));
+  TEST_ASSERT_EQUAL(4, cfg.crntMap);
+}
+
+//---Curtis Bay with a 6 minute window: default route latched at boot
+void test_boot_stored_yard( void )
+{
+  yardConfig cfg;
+  configDefaults(cfg);
+  cfg.crntMap      = 6;
+  cfg.yardDelay[6] = 6;
+  TEST_ASSERT_TRUE(configSave(cfg));
+  bootWith();
+  TEST_ASSERT_TRUE(u8g2.shows("Curtis Bay"));
+  TEST_ASSERT_EQUAL_HEX16(0x0001, shimShiftWord);   // track 1, THROWN_S1
+  runUntil(standingBy, bcsjSeconds(30));
+  TEST_ASSERT_TRUE(u8g2.shows("Rotate"));
+}
+
+//---a click aligns, powers the track for 6 minutes, then drops it
+void test_power_window( void )
+{
+  powerOnAt = powerOffAt = 0;
+  clickIn(bcsjSeconds(1));
+  runUntil(powerCycled, bcsjMinutes(10));
+  TEST_ASSERT_TRUE(powerCycled());
+  TEST_ASSERT_UINT64_WITHIN(bcsjSeconds(1), bcsjMinutes(6), powerOffAt - powerOnAt);
+  runUntil(standingBy, bcsjSeconds(5));
+  TEST_ASSERT_TRUE(u8g2.shows("Rotate"));
+}
+
+//---a train leaving over the main sensor ends the window early
+void test_outbound_passby_ends_window( void )
+{
+  powerOnAt = powerOffAt = 0;
+  bcsjTime64 began = bcsjNow();
+  clickIn(bcsjSeconds(1));
+  pinIn(bcsjSeconds(10), mainOutPin, LOW);     // outbound: the out beam breaks first
+  pinIn(bcsjSeconds(11), mainInPin,  LOW);
+  pinIn(bcsjSeconds(12), mainOutPin, HIGH);
+  pinIn(bcsjSeconds(13), mainInPin,  HIGH);
+  runUntil(powerCycled, bcsjMinutes(10));
+  TEST_ASSERT_TRUE(powerCycled());
+  TEST_ASSERT_UINT64_WITHIN(bcsjMillis(100), bcsjSeconds(13), powerOffAt - began);
+  runUntil(standingBy, bcsjSeconds(5));
+  TEST_ASSERT_TRUE(u8g2.shows("Rotate"));
+}
+
+//---long press into the menu during the window: the sensors stay live and
+//   an outbound train still ends the window under the menu
+void test_menu_outbound_passby( void )
+{
+  powerOnAt = powerOffAt = 0;
+  bcsjTime64 began = bcsjNow();
+  clickIn(bcsjSeconds(1));
+  pinIn(bcsjSeconds(8),  switchPin, LOW);      // 6 s hold opens the menu
+  pinIn(bcsjSeconds(15), switchPin, HIGH);
+  pinIn(bcsjSeconds(20), mainOutPin, LOW);
+  pinIn(bcsjSeconds(21), mainInPin,  LOW);
+  pinIn(bcsjSeconds(22), mainOutPin, HIGH);
+  pinIn(bcsjSeconds(23), mainInPin,  HIGH);
+  runUntil(inMenu, bcsjSeconds(19));
+  TEST_ASSERT_TRUE(inMenu());
+  TEST_ASSERT_EQUAL(HIGH, shimPinLevel[powerPin]);
+  runUntil(powerCycled, bcsjMinutes(10));
+  TEST_ASSERT_TRUE(powerCycled());
+  TEST_ASSERT_UINT64_WITHIN(bcsjMillis(100), bcsjSeconds(23), powerOffAt - began);
+  TEST_ASSERT_TRUE(inMenu());
+}
+
+int main( int argc, char **argv )
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_boot_defaults);
+  RUN_TEST(test_config_ranges);
+  RUN_TEST(test_boot_stored_yard);
+  RUN_TEST(test_power_window);
+  RUN_TEST(test_outbound_passby_ends_window);
+  RUN_TEST(test_menu_outbound_passby);
+  return UNITY_END();
+}
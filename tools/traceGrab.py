@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+traceGrab.py - fetch an input trace from the panel, or cut one out of a log
+
+The firmware has to be built with -DTRACE_CAPTURE=1 (pio run -e
+esp32dev_trace).  It records from boot; a "T" line on the serial port in
+STAND_BY sends everything since then as one binary frame, see
+lib/inputTrace.
+
+    traceGrab.py --port /dev/ttyUSB0 session.trc
+    traceGrab.py --log monitor.log session.trc
+    traceGrab.py --log session.trc --c-array curtis_bay_evening \\
+                 test/test_trace/golden/curtis_bay_evening.h
+
+A trace written with --c-array is a golden for test/test_trace: add it to
+test/test_trace/goldens.h and the host replay has to reproduce its route,
+power and mode changes.  Needs pyserial for --port.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+MAGIC = b"BTRC"
+HEAD = 14                                  # version .. body bytes
+VERSION = 1
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def frame_at(buf, at):
+    """Length of a complete frame at buf[at], 0 if not there yet, -1 if bad."""
+    head = buf[at + 4:at + 4 + HEAD]
+    if len(head) < HEAD:
+        return 0
+    version, boot, _records, _lost, _span, body = struct.unpack("<BBHHII", head)
+    if version != VERSION:
+        return -1
+    length = 4 + HEAD + boot + body + 2
+    if len(buf) - at < length:
+        return 0
+    sealed = buf[at + 4:at + length - 2]
+    (crc,) = struct.unpack("<H", buf[at + length - 2:at + length])
+    return length if crc16(sealed) == crc else -1
+
+
+def find_frame(buf):
+    at = buf.find(MAGIC)
+    while at >= 0:
+        length = frame_at(buf, at)
+        if length > 0:
+            return buf[at:at + length]
+        if length == 0:
+            return None
+        at = buf.find(MAGIC, at + 1)
+    return None
+
+
+def grab(port, baud, timeout):
+    import serial                          # pyserial
+
+    with serial.Serial(port, baud, timeout=0.2) as line:
+        line.reset_input_buffer()
+        line.write(b"\nT\n")             # the blank line wakes a sleeping board
+        buf = b""
+        end = time.time() + timeout
+        while time.time() < end:
+            buf += line.read(4096)
+            trace = find_frame(buf)
+            if trace:
+                return trace
+    return None
+
+
+def summary(trace):
+    _, boot, records, lost, span, body = struct.unpack("<BBHHII", trace[4:4 + HEAD])
+    text = "%d records, %.1f s, %d bytes" % (records, span / 1e6, len(trace))
+    if lost:
+        text += ", %d lost: replay stops at the last record" % lost
+    return text
+
+
+def c_array(name, trace):
+    lines = ["// %s - input trace, %s" % (name, summary(trace)),
+             "// made by tools/traceGrab.py --c-array",
+             "",
+             "static const uint8_t %s[] = {" % name]
+    for i in range(0, len(trace), 16):
+        lines.append("  " + " ".join("0x%02x," % b for b in trace[i:i + 16]))
+    lines += ["};", ""]
+    return "\n".join(lines)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="fetch an input trace from the panel")
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="serial port of the panel")
+    src.add_argument("--log", help="saved serial output or .trc file to cut it from")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--timeout", type=float, default=10.0, help="seconds to wait for the frame")
+    ap.add_argument("--c-array", metavar="NAME", help="write a C header for test/test_trace")
+    ap.add_argument("out")
+    args = ap.parse_args()
+
+    if args.port:
+        trace = grab(args.port, args.baud, args.timeout)
+    else:
+        with open(args.log, "rb") as f:
+            trace = find_frame(f.read())
+    if trace is None:
+        sys.exit("no complete trace frame (was the firmware built with TRACE_CAPTURE=1?)")
+
+    if args.c_array:
+        with open(args.out, "w") as f:
+            f.write(c_array(args.c_array, trace))
+    else:
+        with open(args.out, "wb") as f:
+            f.write(trace)
+    print("%s: %s" % (args.out, summary(trace)))
+
+
+if __name__ == "__main__":
+    main()
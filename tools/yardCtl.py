@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""
+yardCtl.py - drive a panel from its serial line
+
+Sends the one line commands serviceSerial() in src/main.cpp takes and
+prints the reply.  The actions go in as the panel's own knob moves and
+clicks, so the board refuses what the operator could not do at that
+moment ("ERR mode", "ERR busy", "ERR occupied").
+
+    yardCtl.py --port /dev/ttyUSB0 mode
+    yardCtl.py --port /dev/ttyUSB0 align 5
+    yardCtl.py --port /dev/ttyUSB0 config tortoiseMs=2500 flags=0x05
+    yardCtl.py --port /dev/ttyUSB0 --script evening.txt
+
+A script has one command per line, the same words as on the command
+line, and three more for regression runs against a real board:
+
+    wait STAND_BY 30        poll "mode" until it says STAND_BY, 30 s at most
+    expect power ON         fail unless the last reply has this in it
+    sleep 2.5
+
+"#" starts a comment.  The script stops at the first ERR or failed
+expect and the exit status says so.  Telemetry frames on the line are
+skipped; tools/yardTelemetry.py reads those.  Needs pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+# yardConfig in lib/yardConfig/yardConfig.h, packed, little endian
+CONFIG_FIELDS = ["magic", "version", "crntMap"] + ["yardDelay%d" % i for i in range(8)] + \
+                ["tortoiseMs", "debounceMs", "screenTimeoutSec", "preAlignMs",
+                 "flags", "autoRoutePolicy", "ladderClearSec", "crc"]
+CONFIG_FORMAT = "<HBB8BHHHHBBBH"
+
+COMMANDS = {"select": "S", "align": "A", "extend": "E", "cut": "X",
+            "mode": "M", "sensors": "I", "stats": "P", "bench": "B"}
+REPLIES = ("OK", "ERR", "MODE", "SENS", "STATS", "CONFIG")
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+class Panel:
+    def __init__(self, port, baud, timeout):
+        import serial                      # pyserial
+        self.line = serial.Serial(port, baud, timeout=0.1)
+        self.timeout = timeout
+        self.pending = b""
+
+    def lines(self):
+        """Text lines from the port.  A line always starts right after the
+        zero that ends a telemetry frame, or at the start of the output."""
+        self.pending += self.line.read(256)
+        *done, self.pending = self.pending.split(b"\r\n")
+        for segment in done:
+            text = segment.rsplit(b"\0", 1)[-1]
+            if text and all(32 <= b < 127 for b in text):
+                yield text.decode("ascii")
+
+    def send(self, command):
+        """One command, returns its reply line; anything printed before it
+        (bench results) goes to stdout."""
+        self.line.write(b"\n")             # wakes a sleeping board, then ignored
+        time.sleep(0.05)
+        self.line.reset_input_buffer()
+        self.pending = b""
+        self.line.write(command.encode("ascii") + b"\n")
+        end = time.time() + self.timeout
+        while time.time() < end:
+            for text in self.lines():
+                if text.startswith(REPLIES):
+                    return text
+                print(text)
+        return "ERR timeout"
+
+
+def config_line(panel, changes):
+    reply = panel.send("C")
+    if not reply.startswith("CONFIG "):
+        return reply
+    values = dict(zip(CONFIG_FIELDS, struct.unpack(CONFIG_FORMAT, bytes.fromhex(reply[7:]))))
+    if not changes:
+        return "\n".join("%-16s %s" % (k, values[k]) for k in CONFIG_FIELDS)
+    for change in changes:
+        key, _, value = change.partition("=")
+        if key not in values or key in ("magic", "version", "crc"):
+            return "ERR no field %s" % key
+        values[key] = int(value, 0)
+    raw = struct.pack(CONFIG_FORMAT, *[values[k] for k in CONFIG_FIELDS])
+    raw = raw[:-2] + struct.pack("<H", crc16(raw[:-2]))
+    return panel.send("C " + raw.hex())
+
+
+def run(panel, words, last):
+    """One command from the command line or a script, returns its reply."""
+    verb, args = words[0].lower(), words[1:]
+    if verb == "config":
+        return config_line(panel, args)
+    if verb == "raw":
+        return panel.send(" ".join(args))
+    if verb == "sleep":
+        time.sleep(float(args[0]))
+        return "OK"
+    if verb == "expect":
+        want = " ".join(args)
+        return "OK" if want in last else "ERR expected %s" % want
+    if verb == "wait":
+        end = time.time() + (float(args[1]) if len(args) > 1 else 60.0)
+        while time.time() < end:
+            reply = panel.send("M")
+            if reply.startswith("MODE %s " % args[0]):
+                return reply
+            time.sleep(0.5)
+        return "ERR no %s" % args[0]
+    if verb in COMMANDS:
+        return panel.send(" ".join([COMMANDS[verb]] + args))
+    return "ERR unknown %s" % verb
+
+
+def main():
+    ap = argparse.ArgumentParser(description="drive a panel from its serial line")
+    ap.add_argument("--port", required=True, help="serial port of the panel")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--timeout", type=float, default=5.0, help="seconds to wait for a reply")
+    ap.add_argument("--script", help="file of commands, one per line")
+    ap.add_argument("command", nargs="*",
+                    help="select N, align [N], extend, cut, mode, sensors, stats, "
+                         "config [field=value ...], bench, raw LINE")
+    args = ap.parse_args()
+
+    panel = Panel(args.port, args.baud, args.timeout)
+    if args.script:
+        with open(args.script) as f:
+            steps = [l.split("#")[0].split() for l in f]
+    else:
+        steps = [args.command] if args.command else []
+    if not steps:
+        ap.error("nothing to do")
+
+    last = ""
+    for number, words in enumerate(steps, 1):
+        if not words:
+            continue
+        reply = run(panel, words, last)
+        print(reply)
+        if reply.startswith("ERR"):
+            if args.script:
+                sys.exit("%s:%d: %s" % (args.script, number, " ".join(words)))
+            sys.exit(1)
+        last = reply
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+yardTelemetry.py - decode the panel's binary telemetry stream
+
+The firmware logs through lib/telemetry: COBS frames, each between zero
+bytes, holding type, ms since boot, payload and a CRC-8.  This prints one
+line per frame and passes any plain text between frames (bench results)
+through as it is.
+
+    yardTelemetry.py --port /dev/ttyUSB0
+    yardTelemetry.py --log capture.bin
+
+Needs pyserial for --port.  What the board sends at all is picked at
+compile time with LOG_LEVEL (0 none .. 4 debug); only builds with it set,
+such as pio run -e esp32dev_log, send any frames.
+"""
+
+import argparse
+import struct
+import sys
+
+MODES = ["HOUSEKEEP", "STAND_BY", "TRACK_SETUP", "TRACK_ACTIVE",
+         "OCCUPIED", "MENU", "REV_LOOP", "BOOT"]
+LEVELS = {1: "ERROR", 2: "WARN", 3: "INFO", 4: "DEBUG"}
+TIMINGS = ["boot first sample", "flash commit", "idle wake max",   # logTiming
+           "power trip"]
+DIRECTIONS = {0: "-", 1: "INBOUND", 2: "OUTBOUND"}
+PAIRS = ["mainSens", "revSens"]
+
+EV_TEXT, EV_MODE, EV_SENSOR, EV_ROUTE, EV_TIMING, EV_DROPPED = range(1, 7)
+
+
+def crc8(data):
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) if crc & 0x80 else (crc << 1)
+            crc &= 0xFF
+    return crc
+
+
+def uncobs(chunk):
+    out = bytearray()
+    i = 0
+    while i < len(chunk):
+        code = chunk[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(chunk):
+            return None
+        out += chunk[i:i + code - 1]
+        i += code - 1
+        if code < 0xFF and i < len(chunk):
+            out.append(0)
+    return bytes(out)
+
+
+def name(table, i):
+    if isinstance(table, dict):
+        return table.get(i, str(i))
+    return table[i] if i < len(table) else str(i)
+
+
+def describe(raw):
+    kind, ms = raw[0], struct.unpack("<I", raw[1:5])[0]
+    body = raw[5:]
+    stamp = "%10.3f" % (ms / 1000.0)
+    if kind == EV_TEXT:
+        return "%s %-5s %s" % (stamp, name(LEVELS, body[0]), body[1:].decode("ascii", "replace"))
+    if kind == EV_MODE:
+        return "%s MODE  %s -> %s" % (stamp, "-" if body[0] == 0xFF else name(MODES, body[0]),
+                                      name(MODES, body[1]))
+    if kind == EV_SENSOR:
+        pair, report, direction, passby = body[:4]
+        return "%s SENS  %s report %d%d %s%s" % (stamp, name(PAIRS, pair), report >> 1 & 1,
+                                                 report & 1, name(DIRECTIONS, direction),
+                                                 " PassBy" if passby else "")
+    if kind == EV_ROUTE:
+        track, word = struct.unpack("<HH", body[:4])
+        return "%s ROUTE track %d word 0x%04x" % (stamp, track, word)
+    if kind == EV_TIMING:
+        ident, us = body[0], struct.unpack("<I", body[1:5])[0]
+        return "%s TIME  %s %d us" % (stamp, name(TIMINGS, ident), us)
+    if kind == EV_DROPPED:
+        return "%s LOST  %d frames, UART could not keep up" % (stamp, struct.unpack("<H", body[:2])[0])
+    return "%s ?%d    %s" % (stamp, kind, body.hex())
+
+
+def decode(chunk):
+    """One line for a chunk between zeros, None for nothing to show."""
+    if not chunk:
+        return None
+    raw = uncobs(chunk)
+    if raw and len(raw) >= 6 and crc8(raw[:-1]) == raw[-1]:
+        try:
+            return describe(raw[:-1])
+        except (IndexError, struct.error):
+            pass
+    text = chunk.decode("ascii", "replace").strip()
+    return text or None
+
+
+def stream(read, follow=False):
+    pending = b""
+    while True:
+        data = read()
+        if not data:
+            if follow:
+                continue
+            break
+        pending += data
+        *chunks, pending = pending.split(b"\0")
+        for chunk in chunks:
+            line = decode(chunk)
+            if line:
+                print(line, flush=True)
+    line = decode(pending)
+    if line:
+        print(line)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="decode the panel's telemetry stream")
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--port", help="serial port of the panel")
+    src.add_argument("--log", help="raw capture of the serial line")
+    ap.add_argument("--baud", type=int, default=115200)
+    args = ap.parse_args()
+
+    if args.log:
+        with open(args.log, "rb") as f:
+            stream(lambda: f.read(4096))
+        return
+    import serial                          # pyserial
+    with serial.Serial(args.port, args.baud, timeout=0.2) as line:
+        try:
+            stream(lambda: line.read(256), follow=True)
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    sys.exit(main())